@@ -3,7 +3,7 @@
 #include "debug.h"
 #include "list.h"
 #include "timer.h"
-#include "myalloc.h"
+#include "slab.h"
 #include "ethernet.h"
 
 #define ARP_OP_REQUEST 1
@@ -63,6 +63,10 @@ typedef struct {
 /* ARP entry cache, in no particular order */
 static list_define(arp_cache);
 
+/* Object caches for ARP entries and queued packets */
+static slab_cache_define(arp_entry_cache, sizeof(arp_entry_t), NULL);
+static slab_cache_define(queue_pkt_cache, sizeof(queue_pkt_t), NULL);
+
 /*
  * Flushes all packets waiting for an ARP reply. If mac is
  * not null, the packets are sent. If it is null, they are dropped.
@@ -78,7 +82,7 @@ arp_queue_flush(arp_entry_t *entry, const mac_addr_t *mac)
         }
         skb_release(pkt->skb);
         list_del(&pkt->list);
-        free(pkt);
+        slab_free(&queue_pkt_cache, pkt);
     }
 }
 
@@ -92,7 +96,7 @@ arp_on_cache_timeout(timer_t *timer)
     arp_entry_t *entry = timer_entry(timer, arp_entry_t, timeout);
     assert(list_empty(&entry->packet_queue));
     list_del(&entry->list);
-    free(entry);
+    slab_free(&arp_entry_cache, entry);
 }
 
 /*
@@ -140,7 +144,7 @@ arp_cache_insert(net_dev_t *dev, ip_addr_t ip, const mac_addr_t *mac)
     /* Find existing entry, or allocate a new one */
     arp_entry_t *entry = arp_cache_find(dev, ip);
     if (entry == NULL) {
-        entry = malloc(sizeof(arp_entry_t));
+        entry = slab_alloc(&arp_entry_cache);
         if (entry == NULL) {
             return NULL;
         }
@@ -181,7 +185,7 @@ arp_queue_insert(net_dev_t *dev, ip_addr_t ip, skb_t *skb)
         return -1;
     }
 
-    queue_pkt_t *pkt = malloc(sizeof(queue_pkt_t));
+    queue_pkt_t *pkt = slab_alloc(&queue_pkt_cache);
     if (pkt == NULL) {
         debugf("Cannot allocate space for packet\n");
         return -1;
@@ -189,7 +193,7 @@ arp_queue_insert(net_dev_t *dev, ip_addr_t ip, skb_t *skb)
 
     skb_t *clone = skb_clone(skb);
     if (clone == NULL) {
-        free(pkt);
+        slab_free(&queue_pkt_cache, pkt);
         debugf("Failed to clone SKB\n");
         return -1;
     }
@@ -85,6 +85,26 @@ bitmap_find_one(bitmap_t *map, int nbits)
     return nbits;
 }
 
+/*
+ * Finds the index of the first '1' bit in the bitmap at or
+ * after the specified index. If there are no such bits, this
+ * will return an index greater than or equal to the actual
+ * number of bits in the bitmap.
+ */
+static inline int
+bitmap_find_next_one(bitmap_t *map, int start, int nbits)
+{
+    int i = bitmap_index(start);
+    bitmap_t unit = map[i] & (~0U << bitmap_subindex(start));
+    while (unit == 0) {
+        if (++i >= bitmap_nunits(nbits)) {
+            return nbits;
+        }
+        unit = map[i];
+    }
+    return i * bitmap_bitsizeof(bitmap_t) + ctz(unit);
+}
+
 /*
  * Finds the index of the first '0' bit in the bitmap.
  * If there are no '0' bits, this will return an index
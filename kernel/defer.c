@@ -0,0 +1,148 @@
+#include "defer.h"
+#include "types.h"
+#include "debug.h"
+#include "printf.h"
+#include "kthread.h"
+
+/*
+ * Maximum number of items each handler may process per pass,
+ * and maximum number of passes per call to defer_run(). This
+ * bounds how long interrupts stay disabled at the end of an
+ * interrupt, even under a packet flood.
+ */
+#define DEFER_BUDGET 16
+#define DEFER_MAX_PASSES 4
+
+/* Per-type state */
+typedef struct {
+    /* Handler for this type of work */
+    defer_handler_t handler;
+
+    /* Number of times the handler was run */
+    uint32_t runs;
+
+    /* Number of times the handler ran out of budget */
+    uint32_t exhausted;
+} defer_t;
+
+/* Deferred work handlers, indexed by type */
+static defer_t defer_types[NUM_DEFER];
+
+/* Bitmap of types with pending work */
+static volatile uint32_t defer_pending_map = 0;
+
+/* Worker thread that finishes work left over by defer_run() */
+static kthread_t defer_thread;
+
+/*
+ * Registers the handler for a type of deferred work.
+ */
+void
+defer_register(int type, defer_handler_t handler)
+{
+    assert(type >= 0 && type < NUM_DEFER);
+    assert(handler != NULL);
+    defer_types[type].handler = handler;
+}
+
+/*
+ * Marks a type of deferred work as pending. The work will be
+ * run at the end of the current interrupt, or by the worker
+ * thread. This may be called from IRQ handlers.
+ */
+void
+defer_raise(int type)
+{
+    assert(type >= 0 && type < NUM_DEFER);
+    defer_pending_map |= 1U << type;
+}
+
+/*
+ * Returns whether there is any pending deferred work.
+ */
+bool
+defer_pending(void)
+{
+    return defer_pending_map != 0;
+}
+
+/*
+ * Runs pending deferred work. Work that is raised by a
+ * handler (e.g. a loopback packet sent in response to a
+ * received one) is picked up in the next pass. If there is
+ * still work remaining after the last pass, it is handed off
+ * to the worker thread, which competes for the CPU with
+ * normal processes instead of running at interrupt time.
+ *
+ * Must be called with interrupts disabled, and not from
+ * inside an IRQ handler.
+ */
+void
+defer_run(void)
+{
+    int pass;
+    for (pass = 0; pass < DEFER_MAX_PASSES && defer_pending_map != 0; ++pass) {
+        int type;
+        for (type = 0; type < NUM_DEFER; ++type) {
+            uint32_t mask = 1U << type;
+            if (!(defer_pending_map & mask)) {
+                continue;
+            }
+
+            defer_pending_map &= ~mask;
+            defer_t *defer = &defer_types[type];
+            if (defer->handler == NULL) {
+                continue;
+            }
+
+            defer->runs++;
+            if (defer->handler(DEFER_BUDGET)) {
+                defer->exhausted++;
+                defer_pending_map |= mask;
+            }
+        }
+    }
+
+    if (defer_pending_map != 0 && defer_thread.pcb != NULL) {
+        kthread_wake(&defer_thread);
+    }
+}
+
+/*
+ * Work function of the worker thread. defer_run() wakes the
+ * thread again if there is still work left.
+ */
+static bool
+defer_worker(void *arg)
+{
+    defer_run();
+    return false;
+}
+
+/*
+ * Prints the statistics of each type of deferred work.
+ */
+void
+defer_dump_state(void)
+{
+    printf("--- DEFER STATE BEGIN ---\n");
+    int i;
+    for (i = 0; i < NUM_DEFER; ++i) {
+        defer_t *defer = &defer_types[i];
+        printf(
+            "%d: pending=%d runs=%u exhausted=%u\n",
+            i,
+            !!(defer_pending_map & (1U << i)),
+            defer->runs,
+            defer->exhausted);
+    }
+}
+
+/*
+ * Starts the deferred work worker thread.
+ */
+void
+defer_init(void)
+{
+    kthread_create(&defer_thread, "defer", defer_worker, NULL, 0);
+}
@@ -0,0 +1,44 @@
+#ifndef _DEFER_H
+#define _DEFER_H
+
+#include "types.h"
+
+/*
+ * Types of deferred work, in the order that they are run.
+ * Received packets come first, so that their ACKs can be
+ * merged before the ACK queue is flushed.
+ */
+#define DEFER_NET_RX   0
+#define DEFER_LOOPBACK 1
+#define DEFER_TCP_ACK  2
+#define NUM_DEFER      3
+
+#ifndef ASM
+
+/*
+ * Deferred work handler. Should process at most budget items
+ * of work, and return true if there is still work remaining.
+ */
+typedef bool (*defer_handler_t)(int budget);
+
+/* Registers the handler for a type of deferred work */
+void defer_register(int type, defer_handler_t handler);
+
+/* Marks a type of deferred work as pending */
+void defer_raise(int type);
+
+/* Returns whether there is any pending deferred work */
+bool defer_pending(void);
+
+/* Runs pending deferred work */
+void defer_run(void);
+
+/* Prints deferred work statistics */
+void defer_dump_state(void);
+
+/* Starts the deferred work worker thread */
+void defer_init(void);
+
+#endif /* ASM */
+
+#endif /* _DEFER_H */
@@ -14,6 +14,7 @@
 #define ELF_VERSION_CURRENT 1
 #define ELF_PROGRAM_TYPE_LOAD 1
 #define ELF_PROGRAM_TYPE_NOTE 4
+#define ELF_PROGRAM_FLAG_WRITE 2
 
 /*
  * If the ELF file has a PT_NOTE segment containing a note with
@@ -258,7 +259,7 @@ elf_is_valid(int inode_idx, bool *out_compat)
  * expanding .bss.
  */
 static uintptr_t
-elf_load_impl_compat(elf_hdr_t *hdr, int inode_idx, uintptr_t paddr)
+elf_load_impl_compat(elf_hdr_t *hdr, int inode_idx, vm_t *vm)
 {
     /*
      * Implementation note: For whatever reason, the PT_LOAD segment
@@ -275,9 +276,10 @@ elf_load_impl_compat(elf_hdr_t *hdr, int inode_idx, uintptr_t paddr)
      * only works with binaries that have been run through `elfconvert`
      * (i.e. .bss must be pre-expanded on disk).
      */
-    void *vaddr = (void *)(TEMP_PAGE_START + ELF_COMPAT_OFFSET);
-    if (fs_read_data(inode_idx, 0, vaddr, MB(4), memcpy) < 0) {
-        debugf("Failed to read program\n");
+    uintptr_t vaddr = USER_PAGE_START + ELF_COMPAT_OFFSET;
+    int max_size = USER_PAGE_END - vaddr;
+    if (vm_map_file(vm, vaddr, max_size, inode_idx, 0, max_size, true) < 0) {
+        debugf("Failed to map program\n");
         return 0;
     }
     return hdr->entry;
@@ -287,7 +289,7 @@ elf_load_impl_compat(elf_hdr_t *hdr, int inode_idx, uintptr_t paddr)
  * Loads an ELF file, properly handling .bss.
  */
 static uintptr_t
-elf_load_impl(elf_hdr_t *hdr, int inode_idx, uintptr_t paddr)
+elf_load_impl(elf_hdr_t *hdr, int inode_idx, vm_t *vm)
 {
     uint32_t i;
     for (i = 0; i < hdr->phnum; ++i) {
@@ -304,19 +306,40 @@ elf_load_impl(elf_hdr_t *hdr, int inode_idx, uintptr_t paddr)
         }
 
         /* Ensure that offset and size look sane */
-        if (phdr.offset > INT_MAX || phdr.filesz > INT_MAX) {
+        if (phdr.offset > INT_MAX || phdr.filesz > INT_MAX - phdr.offset) {
             debugf("Program header offset/filesz too large\n");
             return 0;
         }
 
         /*
-         * Read segment into memory. Note that filesz may be less than memsz,
-         * in which case the extra space is filled with zeros (we already
-         * memset the page to zeros, so it's a op-op).
+         * Since the segment is read lazily, check now that the
+         * file actually contains the entire segment.
          */
-        void *vaddr = (void *)(TEMP_PAGE_START + (phdr.vaddr - USER_PAGE_START));
-        if (fs_read_data(inode_idx, phdr.offset, vaddr, phdr.filesz, memcpy) != (int)phdr.filesz) {
-            debugf("Failed to read program segment\n");
+        uint8_t last;
+        if (phdr.filesz > 0 &&
+            fs_read_data(inode_idx, phdr.offset + phdr.filesz - 1, &last, 1, memcpy) != 1)
+        {
+            debugf("Program segment extends past end of file\n");
+            return 0;
+        }
+
+        /*
+         * Map segment into memory. Its pages are read from the file
+         * when they are first accessed. Note that filesz may be less
+         * than memsz, in which case the extra space is filled with zeros.
+         * Read-only segments are shared between all processes running
+         * this program.
+         */
+        ret = vm_map_file(
+            vm,
+            phdr.vaddr,
+            phdr.memsz,
+            inode_idx,
+            phdr.offset,
+            phdr.filesz,
+            (phdr.flags & ELF_PROGRAM_FLAG_WRITE) != 0);
+        if (ret < 0) {
+            debugf("Failed to map program segment\n");
             return 0;
         }
     }
@@ -330,15 +353,17 @@ elf_load_impl(elf_hdr_t *hdr, int inode_idx, uintptr_t paddr)
 }
 
 /*
- * Loads a program into the user page, returning the virtual
- * address of the entry point. This does not clobber any page
- * mappings. 0 is returned if the program is invalid.
+ * Loads a program into the specified address space, returning
+ * the virtual address of the entry point. The address space must
+ * be newly created. The program is not actually read into memory;
+ * its pages are faulted in on first access. 0 is returned if the
+ * program is invalid.
  *
  * You must validate the program with elf_is_valid() before
  * calling this function.
  */
 uintptr_t
-elf_load(int inode_idx, uintptr_t paddr, bool compat)
+elf_load(int inode_idx, vm_t *vm, bool compat)
 {
     elf_hdr_t hdr;
     if (fs_read_data(inode_idx, 0, &hdr, sizeof(elf_hdr_t), memcpy) != sizeof(elf_hdr_t)) {
@@ -346,22 +371,9 @@ elf_load(int inode_idx, uintptr_t paddr, bool compat)
         return 0;
     }
 
-    /*
-     * Access the user page through a temporary address to avoid
-     * clobbering page mappings.
-     */
-    paging_page_map(TEMP_PAGE_START, paddr, false);
-
-    /* Clear the user page for security and to handle .bss */
-    memset((void *)TEMP_PAGE_START, 0, MB(4));
-
-    uintptr_t ret;
     if (!compat) {
-        ret = elf_load_impl(&hdr, inode_idx, paddr);
+        return elf_load_impl(&hdr, inode_idx, vm);
     } else {
-        ret = elf_load_impl_compat(&hdr, inode_idx, paddr);
+        return elf_load_impl_compat(&hdr, inode_idx, vm);
     }
-
-    paging_page_unmap(TEMP_PAGE_START);
-    return ret;
 }
@@ -2,14 +2,15 @@
 #define _ELF_H
 
 #include "types.h"
+#include "vm.h"
 
 #ifndef ASM
 
 /* Performs basic sanity checks */
 bool elf_is_valid(int inode_idx, bool *out_compat);
 
-/* Loads a program into the user page */
-uintptr_t elf_load(int inode_idx, uintptr_t paddr, bool compat);
+/* Loads a program into an address space */
+uintptr_t elf_load(int inode_idx, vm_t *vm, bool compat);
 
 #endif /* ASM */
 
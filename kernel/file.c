@@ -1,7 +1,7 @@
 #include "file.h"
 #include "types.h"
 #include "debug.h"
-#include "myalloc.h"
+#include "slab.h"
 #include "paging.h"
 #include "filesys.h"
 #include "process.h"
@@ -9,6 +9,12 @@
 /* File type to ops table mapping */
 static const file_ops_t *file_ops_tables[FILE_TYPE_COUNT];
 
+/* Object cache for file objects */
+static slab_cache_define(file_obj_cache, sizeof(file_obj_t), NULL);
+
+/* Object cache for file tables */
+static slab_cache_define(file_table_cache, sizeof(file_table_t), NULL);
+
 /*
  * Returns the file ops table corresponding to the specified
  * file type.
@@ -39,7 +45,7 @@ file_obj_t **
 get_executing_files(void)
 {
     pcb_t *pcb = get_executing_pcb();
-    return pcb->files;
+    return pcb->files->files;
 }
 
 /*
@@ -68,7 +74,7 @@ file_obj_free(file_obj_t *file, bool call_close)
     if (file->inode_idx >= 0) {
         fs_release_inode(file->inode_idx);
     }
-    free(file);
+    slab_free(&file_obj_cache, file);
 }
 
 /*
@@ -81,7 +87,7 @@ file_obj_alloc_impl(const file_ops_t *ops_table, int mode, int inode_idx)
     file_obj_t *ret;
     file_obj_t *file = NULL;
 
-    file = malloc(sizeof(file_obj_t));
+    file = slab_alloc(&file_obj_cache);
     if (file == NULL) {
         debugf("Failed to allocate space for file object\n");
         ret = NULL;
@@ -239,7 +245,7 @@ file_desc_rebind(file_obj_t **files, int fd, file_obj_t *new_file)
 /*
  * Initializes the specified file object array.
  */
-void
+static void
 file_init(file_obj_t **files)
 {
     int i;
@@ -253,7 +259,7 @@ file_init(file_obj_t **files)
  * that of a new process. This will update reference counts
  * accordingly.
  */
-void
+static void
 file_clone(file_obj_t **new_files, file_obj_t **old_files)
 {
     int i;
@@ -270,7 +276,7 @@ file_clone(file_obj_t **new_files, file_obj_t **old_files)
 /*
  * Closes all files in the specified file object array.
  */
-void
+static void
 file_deinit(file_obj_t **files)
 {
     int i;
@@ -279,6 +285,69 @@ file_deinit(file_obj_t **files)
     }
 }
 
+/*
+ * Allocates a new file table with no open files. Returns
+ * NULL if there is not enough memory.
+ */
+file_table_t *
+file_table_alloc(void)
+{
+    file_table_t *table = slab_alloc(&file_table_cache);
+    if (table == NULL) {
+        debugf("Cannot allocate file table\n");
+        return NULL;
+    }
+
+    table->refcnt = 1;
+    file_init(table->files);
+    return table;
+}
+
+/*
+ * Allocates a new file table holding the same open files
+ * as an existing one. Used by fork(), where the child gets
+ * its own descriptors referring to the same file objects.
+ * Returns NULL if there is not enough memory.
+ */
+file_table_t *
+file_table_clone(file_table_t *src)
+{
+    file_table_t *table = file_table_alloc();
+    if (table == NULL) {
+        return NULL;
+    }
+
+    file_clone(table->files, src->files);
+    return table;
+}
+
+/*
+ * Increments the reference count of a file table. Returns
+ * the same table for convenience.
+ */
+file_table_t *
+file_table_retain(file_table_t *table)
+{
+    assert(table->refcnt > 0);
+    table->refcnt++;
+    return table;
+}
+
+/*
+ * Decrements the reference count of a file table. When the
+ * last process using it lets go, all of its files are closed
+ * and the table is freed.
+ */
+void
+file_table_release(file_table_t *table)
+{
+    assert(table->refcnt > 0);
+    if (--table->refcnt == 0) {
+        file_deinit(table->files);
+        slab_free(&file_table_cache, table);
+    }
+}
+
 /*
  * create() syscall handler. Creates a new file object that
  * can be used to access the specified file. Returns the
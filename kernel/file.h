@@ -73,6 +73,19 @@ typedef struct {
     intptr_t private;
 } file_obj_t;
 
+/*
+ * Table of open files. The index in the array corresponds to
+ * the file descriptor. Threads created by clone() share their
+ * creator's table, so it is reference counted.
+ */
+typedef struct {
+    /* Number of processes using this table */
+    int refcnt;
+
+    /* Open file object pointers, NULL if the descriptor is unused */
+    file_obj_t *files[MAX_FILES];
+} file_table_t;
+
 /* File operations table */
 typedef struct file_ops {
     int (*open)(file_obj_t *file);
@@ -108,10 +121,11 @@ int file_desc_bind(file_obj_t **files, int fd, file_obj_t *file);
 int file_desc_unbind(file_obj_t **files, int fd);
 int file_desc_rebind(file_obj_t **files, int fd, file_obj_t *new_file);
 
-/* Initializes/clones the specified file object array */
-void file_init(file_obj_t **files);
-void file_deinit(file_obj_t **files);
-void file_clone(file_obj_t **new_files, file_obj_t **old_files);
+/* File table alloc/clone/retain/release functions */
+file_table_t *file_table_alloc(void);
+file_table_t *file_table_clone(file_table_t *src);
+file_table_t *file_table_retain(file_table_t *table);
+void file_table_release(file_table_t *table);
 
 /* Direct syscall handlers */
 __cdecl int file_create(const char *filename, int mode);
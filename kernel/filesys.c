@@ -6,6 +6,7 @@
 #include "bitmap.h"
 #include "file.h"
 #include "paging.h"
+#include "pagecache.h"
 #include "poll.h"
 
 /* Macros to access inode/data blocks */
@@ -27,11 +28,22 @@
 /* Holds the address of the boot block */
 static boot_block_t *fs_boot_block;
 
+/* Largest value that fits in the inode refcount field */
+#define FS_INODE_REFCNT_MAX ((1 << 9) - 1)
+
 /* Bitmap of allocated dentries/inodes/data blocks */
 static bitmap_t *fs_dentry_map;
 static bitmap_t *fs_inode_map;
 static bitmap_t *fs_data_block_map;
 
+/*
+ * Number of address space mappings referencing each inode.
+ * Files that are mapped into memory (e.g. running programs)
+ * are paged in lazily, so they may not be modified while
+ * they are mapped.
+ */
+static int *fs_inode_mapcnt;
+
 /*
  * Compares a search (NUL-terminated) file name with a
  * potentially non-NUL-terminated raw file name. Essentially
@@ -200,7 +212,7 @@ fs_acquire_inode(int inode_idx)
 {
     assert((uint32_t)inode_idx < fs_boot_block->inode_count);
     assert(bitmap_get(fs_inode_map, inode_idx));
-    assert(fs_inode(inode_idx)->refcnt < (1 << 9) - 1);
+    assert(fs_inode(inode_idx)->refcnt < FS_INODE_REFCNT_MAX);
     fs_inode(inode_idx)->refcnt++;
     return inode_idx;
 }
@@ -224,7 +236,72 @@ fs_release_inode(int inode_idx)
             fs_free_data_block(inode->data_blocks[i]);
         }
         bitmap_clear(fs_inode_map, inode_idx);
+        pagecache_invalidate(inode_idx);
+    }
+}
+
+/*
+ * Returns the size of the specified file in bytes.
+ */
+int
+fs_inode_size(int inode_idx)
+{
+    assert((uint32_t)inode_idx < fs_boot_block->inode_count);
+    return fs_inode(inode_idx)->size;
+}
+
+/*
+ * Returns the physical address of the data block holding
+ * the specified (block-aligned) offset in a file, so that
+ * it can be mapped into memory directly. Returns 0 if the
+ * block is not entirely part of the file, since the rest
+ * of the block may contain stale data.
+ */
+uintptr_t
+fs_inode_block_paddr(int inode_idx, int offset)
+{
+    assert((uint32_t)inode_idx < fs_boot_block->inode_count);
+    assert(offset >= 0 && offset % FS_BLOCK_SIZE == 0);
+
+    inode_t *inode = fs_inode(inode_idx);
+    if (offset + FS_BLOCK_SIZE > (int)inode->size) {
+        return 0;
     }
+
+    /* The filesystem is identity mapped in the kernel page */
+    uintptr_t paddr = (uintptr_t)fs_data(inode->data_blocks[offset / FS_BLOCK_SIZE]);
+    assert(paddr % FRAME_SIZE == 0);
+    return paddr;
+}
+
+/*
+ * Marks the specified inode as being mapped into memory. The
+ * inode cannot be deleted or written to until it is unmapped.
+ * Returns -1 if the inode has too many references.
+ */
+int
+fs_map_inode(int inode_idx)
+{
+    assert((uint32_t)inode_idx < fs_boot_block->inode_count);
+    if (fs_inode(inode_idx)->refcnt >= FS_INODE_REFCNT_MAX) {
+        debugf("Too many references to inode %d\n", inode_idx);
+        return -1;
+    }
+
+    fs_acquire_inode(inode_idx);
+    fs_inode_mapcnt[inode_idx]++;
+    return inode_idx;
+}
+
+/*
+ * Releases a mapping obtained from fs_map_inode().
+ */
+void
+fs_unmap_inode(int inode_idx)
+{
+    assert(fs_inode_mapcnt[inode_idx] > 0);
+    fs_inode_mapcnt[inode_idx]--;
+    fs_release_inode(inode_idx);
 }
 
 /*
@@ -568,6 +645,15 @@ fs_file_write(file_obj_t *file, const void *buf, int nbytes)
         return 0;
     }
 
+    /* Can't modify files that are mapped into memory */
+    if (fs_inode_mapcnt[file->inode_idx] > 0) {
+        debugf("File write failed: file is mapped into memory\n");
+        return -1;
+    }
+
+    /* Cached pages of the file are about to become stale */
+    pagecache_invalidate(file->inode_idx);
+
     /*
      * If open was opened in append mode, seek to end of file
      * as per POSIX spec.
@@ -685,6 +771,15 @@ fs_file_truncate(file_obj_t *file, int length)
         return -1;
     }
 
+    /* Can't modify files that are mapped into memory */
+    if (fs_inode_mapcnt[file->inode_idx] > 0) {
+        debugf("File truncate failed: file is mapped into memory\n");
+        return -1;
+    }
+
+    /* Cached pages of the file are about to become stale */
+    pagecache_invalidate(file->inode_idx);
+
     /* Reallocate data, filling in new data with zeros */
     inode_t *inode = fs_inode(file->inode_idx);
     return fs_resize_inode(inode, length, true);
@@ -701,7 +796,10 @@ fs_generate_bitmaps(void)
     fs_dentry_map = bitmap_alloc(MAX_DENTRIES);
     fs_inode_map = bitmap_alloc(fs_boot_block->inode_count);
     fs_data_block_map = bitmap_alloc(fs_boot_block->data_block_count);
-    if (fs_dentry_map == NULL || fs_inode_map == NULL || fs_data_block_map == NULL) {
+    fs_inode_mapcnt = calloc(fs_boot_block->inode_count, sizeof(int));
+    if (fs_dentry_map == NULL || fs_inode_map == NULL || fs_data_block_map == NULL ||
+        fs_inode_mapcnt == NULL)
+    {
         panic("Failed to allocate filesystem bitmaps\n");
     }
 
@@ -85,6 +85,16 @@ int fs_stat(const char *filename, struct stat *st);
 int fs_acquire_inode(int inode_idx);
 void fs_release_inode(int inode_idx);
 
+/* Prevents an inode from being modified while it is mapped */
+int fs_map_inode(int inode_idx);
+void fs_unmap_inode(int inode_idx);
+
+/* Gets the size of a file in bytes */
+int fs_inode_size(int inode_idx);
+
+/* Gets the physical address of a file's data block */
+uintptr_t fs_inode_block_paddr(int inode_idx, int offset);
+
 /* Finds a dentry by its name */
 int fs_dentry_by_name(const char *fname, dentry_t **dentry);
 
@@ -0,0 +1,132 @@
+#include "futex.h"
+#include "types.h"
+#include "debug.h"
+#include "list.h"
+#include "paging.h"
+#include "process.h"
+#include "scheduler.h"
+#include "signal.h"
+#include "wait.h"
+
+/*
+ * Process waiting on a futex. A futex is identified by its
+ * address space and user address, so only threads sharing
+ * an address space can use the same futex (in particular,
+ * futexes in shared memory segments do not work across
+ * processes).
+ */
+typedef struct {
+    wait_node_t wait;
+    vm_t *vm;
+    int *addr;
+} futex_waiter_t;
+
+/*
+ * All waiting processes, in the order that they started
+ * waiting. There can be at most one waiter per process, so
+ * this is short enough that hashing would not pay off.
+ */
+static list_define(futex_waiters);
+
+/*
+ * Sleeps until another thread calls futex_wake() on the same
+ * address, as long as *addr == val when called. The check and
+ * the enqueue happen with interrupts disabled, so a wakeup that
+ * follows the caller's own write to *addr cannot be lost. Returns 0 if woken, -EAGAIN if the value
+ * did not match, -EINTR if interrupted by a signal, or -1 if
+ * the address is invalid.
+ */
+static int
+futex_wait(int *addr, int val)
+{
+    pcb_t *pcb = get_executing_pcb();
+
+    int curr;
+    if (!copy_from_user(&curr, addr, sizeof(int))) {
+        debugf("Invalid futex address: %p\n", addr);
+        return -1;
+    }
+
+    if (curr != val) {
+        return -EAGAIN;
+    }
+
+    futex_waiter_t waiter;
+    wait_node_init(&waiter.wait, pcb);
+    waiter.vm = pcb->vm;
+    waiter.addr = addr;
+    list_add_tail(&waiter.wait.list, &futex_waiters);
+
+    /* futex_wake() removes us from the list when waking us */
+    int ret;
+    while (1) {
+        if (!wait_node_in_queue(&waiter.wait)) {
+            ret = 0;
+            break;
+        }
+        if (signal_has_pending(pcb->signals)) {
+            ret = -EINTR;
+            break;
+        }
+        scheduler_sleep();
+    }
+
+    wait_queue_remove(&waiter.wait);
+    return ret;
+}
+
+/*
+ * Wakes up to val threads waiting on the futex at the given
+ * address, oldest first. Returns the number of threads woken.
+ */
+static int
+futex_wake(int *addr, int val)
+{
+    vm_t *vm = get_executing_pcb()->vm;
+    int count = 0;
+
+    list_t *pos, *next;
+    list_for_each_safe(pos, next, &futex_waiters) {
+        if (count >= val) {
+            break;
+        }
+
+        futex_waiter_t *waiter = list_entry(pos, futex_waiter_t, wait.list);
+        if (waiter->vm == vm && waiter->addr == addr) {
+            wait_queue_remove(&waiter->wait);
+            scheduler_wake(waiter->wait.pcb);
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/*
+ * futex() syscall handler. If op is FUTEX_WAIT, sleeps until
+ * woken as long as *addr == val. If op is FUTEX_WAKE, wakes
+ * up to val threads waiting on addr. addr must be aligned
+ * to 4 bytes. Returns -1 on invalid arguments; see above
+ * for the other return values.
+ */
+__cdecl int
+futex_futex(int *addr, int op, int val)
+{
+    if ((uintptr_t)addr % sizeof(int) != 0) {
+        debugf("Unaligned futex address: %p\n", addr);
+        return -1;
+    }
+
+    switch (op) {
+    case FUTEX_WAIT:
+        return futex_wait(addr, val);
+    case FUTEX_WAKE:
+        if (val < 0) {
+            return -1;
+        }
+        return futex_wake(addr, val);
+    default:
+        debugf("Invalid futex operation: %d\n", op);
+        return -1;
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef _FUTEX_H
+#define _FUTEX_H
+
+#include "types.h"
+
+/* futex() operations */
+#define FUTEX_WAIT 0
+#define FUTEX_WAKE 1
+
+#ifndef ASM
+
+/* futex() syscall handler */
+__cdecl int futex_futex(int *addr, int op, int val);
+
+#endif /* ASM */
+
+#endif /* _FUTEX_H */
@@ -16,22 +16,6 @@ heap_max_pages(uintptr_t start_vaddr, uintptr_t end_vaddr)
     return div_round_up(end_vaddr - start_vaddr, PAGE_SIZE);
 }
 
-/*
- * Initializes a new userspace heap.
- */
-void
-heap_init_user(heap_t *heap, uintptr_t start_vaddr, uintptr_t end_vaddr)
-{
-    heap->start_vaddr = start_vaddr;
-    heap->end_vaddr = end_vaddr;
-    heap->user = true;
-    heap->mapped = false;
-    heap->size = 0;
-    heap->num_pages = 0;
-    heap->cap_pages = 0;
-    heap->paddrs = NULL;
-}
-
 /*
  * Initializes a new kernel heap. paddrs must point to a
  * statically allocated array (otherwise, expanding the kernel
@@ -44,7 +28,6 @@ heap_init_kernel(heap_t *heap, uintptr_t start_vaddr, uintptr_t end_vaddr, uintp
 {
     heap->start_vaddr = start_vaddr;
     heap->end_vaddr = end_vaddr;
-    heap->user = false;
     heap->mapped = false;
     heap->size = 0;
     heap->num_pages = 0;
@@ -93,6 +76,7 @@ heap_shrink(heap_t *heap, int new_pages)
 {
     assert(new_pages >= 0);
 
+    paging_begin_batch();
     while (heap->num_pages > new_pages) {
         int i = --heap->num_pages;
         uintptr_t vaddr = heap->start_vaddr + i * PAGE_SIZE;
@@ -104,6 +88,7 @@ heap_shrink(heap_t *heap, int new_pages)
 
         paging_page_free(paddr);
     }
+    paging_end_batch();
 }
 
 /*
@@ -134,7 +119,7 @@ heap_grow(heap_t *heap, int new_pages)
         }
 
         if (heap->mapped) {
-            paging_page_map(vaddr, paddr, heap->user);
+            paging_page_map(vaddr, paddr, false);
         }
 
         heap->paddrs[heap->num_pages++] = paddr;
@@ -198,74 +183,6 @@ heap_sbrk(heap_t *heap, int delta)
     return orig_brk;
 }
 
-/*
- * Clones an existing process heap. Note that this currently does
- * not perform copy-on-write optimization.
- *
- * The src heap MUST currently be mapped in memory!
- */
-int
-heap_clone(heap_t *dest, heap_t *src)
-{
-    assert(src->mapped);
-
-    /* Copy properties */
-    dest->start_vaddr = src->start_vaddr;
-    dest->end_vaddr = src->end_vaddr;
-    dest->user = src->user;
-    dest->mapped = false;
-
-    /* Create empty paddrs vector */
-    dest->cap_pages = src->cap_pages;
-    dest->paddrs = NULL;
-    if (dest->cap_pages > 0) {
-        dest->paddrs = malloc(dest->cap_pages * sizeof(uintptr_t));
-        if (dest->paddrs == NULL) {
-            return -1;
-        }
-    }
-
-    /* Allocate same number of pages as src */
-    dest->num_pages = 0;
-    if (heap_grow(dest, src->num_pages) < 0) {
-        free(dest->paddrs);
-        dest->paddrs = NULL;
-        return -1;
-    }
-
-    /*
-     * Copy page contents. Temporary page is necessary since
-     * we need to be able to view both physical addresses
-     * simultaneously, but both have the same virtual address.
-     */
-    int i;
-    for (i = 0; i < dest->num_pages; ++i) {
-        paging_page_map(TEMP_PAGE_START, dest->paddrs[i], false);
-        uintptr_t src_vaddr = src->start_vaddr + i * PAGE_SIZE;
-        memcpy((void *)TEMP_PAGE_START, (const void *)src_vaddr, PAGE_SIZE);
-    }
-    dest->size = src->size;
-
-    paging_page_unmap(TEMP_PAGE_START);
-    return 0;
-}
-
-/*
- * Removes memory mappings for the specified heap.
- */
-void
-heap_unmap(heap_t *heap)
-{
-    assert(heap->mapped);
-    heap->mapped = false;
-
-    int i;
-    for (i = 0; i < heap->num_pages; ++i) {
-        uintptr_t vaddr = heap->start_vaddr + i * PAGE_SIZE;
-        paging_page_unmap(vaddr);
-    }
-}
-
 /*
  * Adds memory mappings for the specified heap.
  */
@@ -278,20 +195,6 @@ heap_map(heap_t *heap)
     int i;
     for (i = 0; i < heap->num_pages; ++i) {
         uintptr_t vaddr = heap->start_vaddr + i * PAGE_SIZE;
-        paging_page_map(vaddr, heap->paddrs[i], heap->user);
+        paging_page_map(vaddr, heap->paddrs[i], false);
     }
 }
-
-/*
- * Deallocates a heap, freeing all pages used by it.
- * This restores the heap to its initial (empty) state.
- */
-void
-heap_clear(heap_t *heap)
-{
-    heap->size = 0;
-    heap_shrink(heap, 0);
-    heap->cap_pages = 0;
-    free(heap->paddrs);
-    heap->paddrs = NULL;
-}
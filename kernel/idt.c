@@ -9,9 +9,13 @@
 #include "process.h"
 #include "signal.h"
 #include "terminal.h"
-#include "loopback.h"
-#include "tcp.h"
+#include "defer.h"
 #include "vbe.h"
+#include "vm.h"
+
+/* Page fault error code bits */
+#define PF_PRESENT 0x1
+#define PF_WRITE   0x2
 
 /* Whether to display a BSOD on a userspace exception (for debugging) */
 #ifndef USER_BSOD
@@ -175,6 +179,20 @@ handle_exception(int_regs_t *regs)
     loop();
 }
 
+/*
+ * Page fault handler. Returns true if the fault was caused
+ * by an access to a demand-paged or copy-on-write user page
+ * and has been resolved, in which case the faulting instruction
+ * can simply be retried.
+ */
+static bool
+handle_page_fault(int_regs_t *regs)
+{
+    uint32_t cr2;
+    asm volatile("movl %%cr2, %0" : "=r"(cr2));
+    return vm_handle_fault(cr2, !!(regs->error_code & PF_WRITE));
+}
+
 /* IRQ handler */
 static void
 handle_irq(int_regs_t *regs)
@@ -200,6 +218,15 @@ handle_syscall(int_regs_t *regs)
 __cdecl void
 idt_handle_interrupt(int_regs_t *regs)
 {
+    /*
+     * User page faults can occur in the middle of kernel code
+     * (e.g. copy_to_user), so return immediately without doing
+     * any of the work below.
+     */
+    if (regs->int_num == EXC_PF && handle_page_fault(regs)) {
+        return;
+    }
+
     if (regs->int_num >= 0 && regs->int_num < NUM_EXC) {
         handle_exception(regs);
     } else if (regs->int_num >= INT_IRQ0 && regs->int_num <= INT_IRQ15) {
@@ -210,11 +237,8 @@ idt_handle_interrupt(int_regs_t *regs)
         debugf("Unknown interrupt: %d\n", regs->int_num);
     }
 
-    /* Deliver queued up loopback packets */
-    loopback_deliver();
-
-    /* Deliver queued up ACKs */
-    tcp_deliver_ack();
+    /* Run deferred work (e.g. received packets) */
+    defer_run();
 
     /*
      * If process has any pending signals, run their handlers.
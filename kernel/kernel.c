@@ -6,8 +6,10 @@
 #include "i8259.h"
 #include "idt.h"
 #include "paging.h"
+#include "pagecache.h"
 #include "process.h"
 #include "scheduler.h"
+#include "timer.h"
 #include "pit.h"
 #include "ps2.h"
 #include "rtc.h"
@@ -24,6 +26,7 @@
 #include "rand.h"
 #include "tcp.h"
 #include "udp.h"
+#include "defer.h"
 
 /* Check if the bit BIT in FLAGS is set. */
 #define CHECK_FLAG(flags, bit) ((flags) & (1 << (bit)))
@@ -169,7 +172,10 @@ entry(uint32_t magic, uint32_t addr)
     idt_init();
 
     printf("Initializing paging...\n");
-    paging_init();
+    paging_init(mbi);
+
+    printf("Initializing page cache...\n");
+    pagecache_init();
 
     printf("Initializing filesystem...\n");
     fs_init((void *)fs_start);
@@ -177,6 +183,9 @@ entry(uint32_t magic, uint32_t addr)
     printf("Initializing PIC...\n");
     i8259_init();
 
+    printf("Initializing timers...\n");
+    timer_init_wheel();
+
     printf("Initializing PIT...\n");
     pit_init();
 
@@ -186,9 +195,18 @@ entry(uint32_t magic, uint32_t addr)
     printf("Initializing RTC...\n");
     rtc_init();
 
+    printf("Initializing scheduler...\n");
+    scheduler_init();
+
     printf("Initializing processes...\n");
     process_init();
 
+    printf("Initializing deferred work...\n");
+    defer_init();
+
+    printf("Initializing page zeroing...\n");
+    paging_zero_init();
+
     printf("Seeding random number generator...\n");
     srand((unsigned int)rtc_realtime());
 
@@ -18,6 +18,7 @@
 #define KC_L         0x26
 #define KC_P         0x19
 #define KC_M         0x32
+#define KC_S         0x1F
 #define KC_F1        0x3B
 #define KC_F2        0x3C
 #define KC_F3        0x3D
@@ -162,6 +163,8 @@ keycode_to_ctrl(uint8_t keycode)
             return KCTL_PANIC;
         case KC_M: /* CTRL-M */
             return KCTL_MEMDUMP;
+        case KC_S: /* CTRL-S */
+            return KCTL_SCHEDDUMP;
         }
         break;
     case KMOD_ALT:
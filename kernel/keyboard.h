@@ -33,6 +33,7 @@ typedef enum {
     KCTL_EOF,       /* Signal EOF in terminal input */
     KCTL_PANIC,     /* Trigger a kernel panic */
     KCTL_MEMDUMP,   /* Dump current kernel heap */
+    KCTL_SCHEDDUMP, /* Dump scheduler queue statistics */
     KCTL_TERM1,     /* Switch to terminal 1 */
     KCTL_TERM2,     /* Switch to terminal 2 */
     KCTL_TERM3,     /* Switch to terminal 3 */
@@ -0,0 +1,101 @@
+#include "kthread.h"
+#include "types.h"
+#include "debug.h"
+#include "list.h"
+#include "printf.h"
+#include "process.h"
+#include "scheduler.h"
+
+/* List of all kernel threads */
+static list_define(kthreads);
+
+/*
+ * Main loop of every kernel thread. Interrupts are briefly
+ * enabled between each call to the work function; this is
+ * the only point where the thread can be preempted.
+ */
+static void
+kthread_main(void)
+{
+    kthread_t *thread = get_executing_pcb()->kthread;
+    assert(thread != NULL);
+
+    while (1) {
+        asm volatile("sti; nop; cli" ::: "memory");
+
+        if (!thread->pending) {
+            scheduler_sleep();
+            continue;
+        }
+
+        thread->pending = false;
+        thread->runs++;
+        if (thread->fn(thread->arg)) {
+            thread->pending = true;
+            scheduler_yield();
+        }
+    }
+}
+
+/*
+ * Creates a new kernel thread that calls fn(arg) whenever
+ * it is woken, and schedules it with the specified nice
+ * value. fn is called once when the thread first runs.
+ * Returns false if the maximum number of processes are
+ * already running.
+ */
+bool
+kthread_create(kthread_t *thread, const char *name, bool (*fn)(void *), void *arg, int nice)
+{
+    assert(fn != NULL);
+
+    pcb_t *pcb = process_create_kernel(kthread_main);
+    if (pcb == NULL) {
+        debugf("Cannot create kernel thread %s\n", name);
+        return false;
+    }
+
+    thread->name = name;
+    thread->fn = fn;
+    thread->arg = arg;
+    thread->pcb = pcb;
+    thread->pending = true;
+    thread->runs = 0;
+    list_add_tail(&thread->list, &kthreads);
+
+    pcb->kthread = thread;
+    pcb->nice = nice;
+    scheduler_add(pcb);
+    return true;
+}
+
+/*
+ * Wakes a kernel thread, so that it will call its work
+ * function again. This may be called from IRQ handlers.
+ */
+void
+kthread_wake(kthread_t *thread)
+{
+    thread->pending = true;
+    scheduler_wake(thread->pcb);
+}
+
+/*
+ * Prints the state of every kernel thread.
+ */
+void
+kthread_dump_state(void)
+{
+    printf("--- KTHREAD STATE BEGIN ---\n");
+    list_t *pos;
+    list_for_each(pos, &kthreads) {
+        kthread_t *thread = list_entry(pos, kthread_t, list);
+        printf(
+            "%s: pid=%d nice=%d pending=%d runs=%u\n",
+            thread->name,
+            thread->pcb->pid,
+            thread->pcb->nice,
+            thread->pending,
+            thread->runs);
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef _KTHREAD_H
+#define _KTHREAD_H
+
+#include "types.h"
+#include "list.h"
+#include "process.h"
+
+#ifndef ASM
+
+/*
+ * Kernel thread. This is a process that runs entirely in
+ * kernel mode, with no address space or files of its own,
+ * used to run background work at a controlled priority
+ * instead of inside interrupt handlers or the idle loop.
+ *
+ * The thread repeatedly calls fn with arg whenever it has
+ * been woken by kthread_wake(). fn should do a bounded
+ * amount of work and return true if there is more to do,
+ * in which case it will be called again after other
+ * processes (and pending interrupts) have had a chance
+ * to run. Otherwise, the thread sleeps until it is woken
+ * up again.
+ */
+typedef struct kthread {
+    /* Node in the list of all kernel threads */
+    list_t list;
+
+    /* Name of the thread, for debugging */
+    const char *name;
+
+    /* Work function and its argument */
+    bool (*fn)(void *arg);
+    void *arg;
+
+    /* Process that executes this thread */
+    pcb_t *pcb;
+
+    /* Whether the thread has been woken since fn last ran */
+    bool pending;
+
+    /* Number of times fn was called */
+    uint32_t runs;
+} kthread_t;
+
+/* Creates and starts a new kernel thread */
+bool kthread_create(kthread_t *thread, const char *name, bool (*fn)(void *), void *arg, int nice);
+
+/* Wakes a kernel thread so that it calls its work function */
+void kthread_wake(kthread_t *thread);
+
+/* Prints the state of all kernel threads */
+void kthread_dump_state(void);
+
+#endif /* ASM */
+
+#endif /* _KTHREAD_H */
@@ -111,6 +111,23 @@ list_del(list_t *node)
     node->prev = node;
 }
 
+/*
+ * Moves all nodes in list to the tail of head,
+ * leaving list empty.
+ */
+static inline void
+list_splice_tail_init(list_t *list, list_t *head)
+{
+    if (list->next != list) {
+        list->next->prev = head->prev;
+        list->prev->next = head;
+        head->prev->next = list->next;
+        head->prev = list->prev;
+        list->next = list;
+        list->prev = list;
+    }
+}
+
 /*
  * Checks whether the list is empty.
  */
@@ -5,6 +5,7 @@
 #include "net.h"
 #include "ip.h"
 #include "skb.h"
+#include "defer.h"
 
 /* Packets that are waiting to be sent */
 static list_define(loopback_queue);
@@ -24,8 +25,8 @@ static net_iface_t lo = {
 
 /*
  * Loopback "send" function - just redirects the packet
- * to the IP rx handler. Packets will be delivered at the
- * end of the current interrupt.
+ * to the IP rx handler. Packets will be delivered as
+ * deferred work at the end of the current interrupt.
  */
 static int
 loopback_send(net_iface_t *iface, skb_t *skb, ip_addr_t ip)
@@ -49,27 +50,30 @@ loopback_send(net_iface_t *iface, skb_t *skb, ip_addr_t ip)
     skb_clear_network_header(clone);
     skb_clear_transport_header(clone);
     list_add_tail(&clone->list, &loopback_queue);
+    defer_raise(DEFER_LOOPBACK);
     return 0;
 }
 
 /*
- * Delivers any queued loopback packets. Called at the end of
- * every interrupt.
+ * Delivers up to budget queued loopback packets. Returns
+ * whether there are still packets in the queue.
  */
-void
-loopback_deliver(void)
+static bool
+loopback_deliver(int budget)
 {
-    while (!list_empty(&loopback_queue)) {
+    while (!list_empty(&loopback_queue) && budget-- > 0) {
         skb_t *pending = list_first_entry(&loopback_queue, skb_t, list);
         list_del(&pending->list);
         ip_handle_rx(&lo, pending);
         skb_release(pending);
     }
+    return !list_empty(&loopback_queue);
 }
 
 /* Initializes the loopback interface */
 void
 loopback_init(void)
 {
+    defer_register(DEFER_LOOPBACK, loopback_deliver);
     net_register_interface(&lo);
 }
@@ -5,6 +5,10 @@
 #define MULTIBOOT_HEADER_MAGIC          0x1BADB002
 #define MULTIBOOT_BOOTLOADER_MAGIC      0x2BADB002
 
+/* Flags in multiboot_info_t */
+#define MULTIBOOT_INFO_MEMORY           0x00000001
+#define MULTIBOOT_INFO_MMAP             0x00000040
+
 #ifndef ASM
 
 #include "types.h"
@@ -3,8 +3,10 @@
  *
  * This allocator aims to follow in the spirit of the glibc implementation,
  * but with simplicity as the main design goal, instead of efficiency or
- * scalability. It uses a single free list instead of grouping blocks
- * into buckets, and is not at all thread safe.
+ * scalability. Free blocks are grouped into bins by size: small blocks
+ * get one bin per exact size, larger blocks get one bin per power of 2.
+ * A bitmap of non-empty bins lets us find a fitting block without
+ * walking every free block. It is not at all thread safe.
  *
  * Some assumptions made:
  * - 2's complement, little endian, 8 bits per byte
@@ -21,6 +23,7 @@
 #include "paging.h"
 #include "heap.h"
 #include "printf.h"
+#include "bitmap.h"
 
 /*
  * Whether to poison new allocations with an invalid pattern to
@@ -51,6 +54,15 @@
  */
 #define MYA_SBRK_ALIGN PAGE_SIZE
 
+/*
+ * Free list bins. Blocks up to MYA_SMALL_MAX bytes are binned
+ * by exact size; larger blocks are binned by the position of
+ * their highest set bit. The last bin holds everything else.
+ */
+#define MYA_SMALL_MAX 512
+#define MYA_NUM_SMALL_BINS ((int)(MYA_SMALL_MAX / MYA_DATA_ALIGN))
+#define MYA_NUM_BINS (MYA_NUM_SMALL_BINS + 24)
+
 /*
  * Masks for extracting the size and flags out of the
  * header info fields.
@@ -144,10 +156,15 @@ typedef struct mya_header {
 } mya_header_t;
 
 /*
- * Doubly linked list of free blocks. If there are no free blocks,
- * this will be NULL.
+ * Doubly linked lists of free blocks, one per bin. If there are
+ * no free blocks in a bin, its list will be NULL.
  */
-static mya_header_t *mya_free_list = NULL;
+static mya_header_t *mya_bins[MYA_NUM_BINS];
+
+/*
+ * Bitmap of bins that have at least one free block.
+ */
+static bitmap_define(mya_bin_map, MYA_NUM_BINS);
 
 /*
  * This caches the value of the last call to sbrk, so that we can
@@ -167,23 +184,42 @@ static uintptr_t mya_kernel_heap_paddrs[(KERNEL_HEAP_END - KERNEL_HEAP_START) /
 static heap_t mya_kernel_heap;
 
 /*
- * Adds a block to the free list. Upon entry,
+ * Returns the index of the bin that holds free blocks
+ * with the specified user data size.
+ */
+static int
+mya_bin_index(size_t size)
+{
+    if (size <= MYA_SMALL_MAX) {
+        return size / MYA_DATA_ALIGN - 1;
+    }
+
+    /* log2(MYA_SMALL_MAX) == 9, so 513 goes in the first large bin */
+    int log = 31 - clz(size);
+    return min(MYA_NUM_SMALL_BINS + log - 9, MYA_NUM_BINS - 1);
+}
+
+/*
+ * Adds a block to the free list of its bin. Upon entry,
  * prev_free and next_free may be in an invalid state.
  */
 static void
 mya_add_free_list(mya_header_t *header)
 {
+    int bin = mya_bin_index(mya_size(curr, header));
     header->prev_free = NULL;
-    header->next_free = mya_free_list;
-    if (mya_free_list != NULL) {
-        mya_free_list->prev_free = header;
+    header->next_free = mya_bins[bin];
+    if (mya_bins[bin] != NULL) {
+        mya_bins[bin]->prev_free = header;
     }
-    mya_free_list = header;
+    mya_bins[bin] = header;
+    bitmap_set(mya_bin_map, bin);
 }
 
 /*
- * Removes a block from the free list. Upon exit,
- * prev_free and next_free may be in an invalid state.
+ * Removes a block from the free list of its bin. Upon exit,
+ * prev_free and next_free may be in an invalid state. The block
+ * size must not have changed since it was added.
  */
 static void
 mya_remove_free_list(mya_header_t *header)
@@ -191,8 +227,12 @@ mya_remove_free_list(mya_header_t *header)
     mya_header_t *prev_free = header->prev_free;
     mya_header_t *next_free = header->next_free;
 
-    if (mya_free_list == header) {
-        mya_free_list = next_free;
+    int bin = mya_bin_index(mya_size(curr, header));
+    if (mya_bins[bin] == header) {
+        mya_bins[bin] = next_free;
+        if (next_free == NULL) {
+            bitmap_clear(mya_bin_map, bin);
+        }
     }
 
     if (prev_free != NULL) {
@@ -221,6 +261,12 @@ mya_coalesce_next(mya_header_t *header)
     /* Remove next adjacent block from free list */
     mya_remove_free_list(next_adj);
 
+    /* Free blocks are binned by size, so re-bin this one too */
+    bool is_free = !mya_used(curr, header);
+    if (is_free) {
+        mya_remove_free_list(header);
+    }
+
     /* New size equals combined size of two blocks plus header overhead */
     size_t new_size = mya_size(curr, header) + MYA_INFO_SIZE + mya_size(curr, next_adj);
 
@@ -232,6 +278,10 @@ mya_coalesce_next(mya_header_t *header)
     /* Update size of the current block */
     mya_set_size(curr, header, new_size);
 
+    if (is_free) {
+        mya_add_free_list(header);
+    }
+
     return true;
 }
 
@@ -354,12 +404,15 @@ mya_initialize(void)
 /*
  * Finds a block that is large enough to fit an allocation
  * with the specified user data size, or NULL if there are
- * no available blocks that are large enough.
+ * no available blocks that are large enough. Only the bin
+ * that the size falls into needs to be searched for a best
+ * fit; every block in a higher bin is large enough.
  */
 static mya_header_t *
 mya_find_free_block(size_t aligned_size)
 {
-    mya_header_t *header = mya_free_list;
+    int bin = mya_bin_index(aligned_size);
+    mya_header_t *header = mya_bins[bin];
     mya_header_t *best = NULL;
     while (header != NULL) {
         if (mya_size(curr, header) >= aligned_size) {
@@ -369,6 +422,14 @@ mya_find_free_block(size_t aligned_size)
         }
         header = header->next_free;
     }
+
+    if (best == NULL && bin + 1 < MYA_NUM_BINS) {
+        bin = bitmap_find_next_one(mya_bin_map, bin + 1, MYA_NUM_BINS);
+        if (bin < MYA_NUM_BINS) {
+            best = mya_bins[bin];
+        }
+    }
+
     return best;
 }
 
@@ -412,8 +473,9 @@ mya_sbrk_new_block(size_t aligned_size)
 }
 
 /*
- * Attempts to split a block into two smaller blocks, with the first
- * having size >= aligned_size. If the block is too small, returns NULL.
+ * Attempts to split an allocated block into two smaller blocks, with
+ * the first having size >= aligned_size. If the block is too small,
+ * returns NULL.
  * Otherwise, returns a pointer to the second block, which will be unused.
  * The second block may be coalesced with the next adjacent block.
  */
@@ -510,9 +572,6 @@ malloc(size_t size)
         }
     }
 
-    /* Split the block as necessary */
-    mya_split_block(header, aligned_size);
-
     /* Remove block from the free list */
     mya_remove_free_list(header);
 
@@ -520,6 +579,9 @@ malloc(size_t size)
     mya_set_used(curr, header, 1);
     mya_set_used(prev, mya_next(header), 1);
 
+    /* Split the block as necessary */
+    mya_split_block(header, aligned_size);
+
     /* Return pointer to the user data */
     void *ptr = mya_header_to_data(header);
     mya_poison(ptr, aligned_size, MYA_POISON_UNINIT);
@@ -656,7 +718,9 @@ realloc(void *ptr, size_t size)
 }
 
 /*
- * Prints a summary of the current heap state.
+ * Prints a summary of the current heap state, followed
+ * by the number and total size of free blocks in each
+ * non-empty bin.
  */
 void
 mya_dump_state(void)
@@ -675,4 +739,25 @@ mya_dump_state(void)
             mya_used(curr, hdr));
         hdr = mya_next(hdr);
     }
+
+    printf("--- HEAP BINS BEGIN ---\n");
+    int bin;
+    for (bin = 0; bin < MYA_NUM_BINS; ++bin) {
+        if (!bitmap_get(mya_bin_map, bin)) {
+            continue;
+        }
+
+        int count = 0;
+        size_t total = 0;
+        for (hdr = mya_bins[bin]; hdr != NULL; hdr = hdr->next_free) {
+            count++;
+            total += mya_size(curr, hdr);
+        }
+
+        printf(
+            "bin %d: count=%d total=%u\n",
+            bin,
+            count,
+            total);
+    }
 }
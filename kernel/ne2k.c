@@ -7,6 +7,7 @@
 #include "skb.h"
 #include "net.h"
 #include "ethernet.h"
+#include "defer.h"
 
 /*
  * Interestingly, the NE2000 works a lot like the Sound Blaster 16.
@@ -185,6 +186,17 @@ static volatile int ne2k_tx_buf_len[2];
 /* Packets waiting to be sent */
 static list_define(ne2k_tx_queue);
 
+/*
+ * Maximum number of received packets waiting to be processed.
+ * Once this is reached, further packets are left in the NE2k
+ * ring buffer until there is room.
+ */
+#define NE2K_RX_QUEUE_MAX 64
+
+/* Packets waiting to be processed, and the length of the queue */
+static list_define(ne2k_rx_queue);
+static int ne2k_rx_queue_len = 0;
+
 /* Sets the remote DMA byte offset and count */
 static void
 ne2k_config_dma(int offset, int nbytes)
@@ -374,13 +386,14 @@ ne2k_reset(void)
 }
 
 /*
- * Packet receive handler. This will deliver any good
- * packets to the Ethernet level for further processing.
+ * Packet receive handler. This copies good packets out of
+ * the NE2k ring buffer into the receive queue, to be passed
+ * to the Ethernet level later by ne2k_deliver_rx().
  */
 static void
 ne2k_handle_rx(void)
 {
-    while (true) {
+    while (ne2k_rx_queue_len < NE2K_RX_QUEUE_MAX) {
         /* Read the current page (aka the tail of the ring buffer) */
         outb(NE2K_CMD_PAGE1, NE2K_CMD);
         uint8_t tail_pg = inb(NE2K_CURPAG);
@@ -421,9 +434,10 @@ ne2k_handle_rx(void)
             void *body = skb_put(skb, eth_size);
             ne2k_read_mem(body, offset + sizeof(ne2k_hdr_t), eth_size);
 
-            /* Deliver packet to Ethernet layer */
-            ethernet_handle_rx(&ne2k_dev, skb);
-            skb_release(skb);
+            /* Queue packet for the Ethernet layer */
+            list_add_tail(&skb->list, &ne2k_rx_queue);
+            ne2k_rx_queue_len++;
+            defer_raise(DEFER_NET_RX);
         } else {
             debugf("Received invalid packet, dropping\n");
         }
@@ -437,6 +451,28 @@ ne2k_handle_rx(void)
     }
 }
 
+/*
+ * Delivers up to budget received packets to the Ethernet
+ * layer. This runs as deferred work rather than in the IRQ
+ * handler, since it goes all the way up the network stack.
+ * Returns whether there are still packets to be delivered.
+ */
+static bool
+ne2k_deliver_rx(int budget)
+{
+    while (!list_empty(&ne2k_rx_queue) && budget-- > 0) {
+        skb_t *skb = list_first_entry(&ne2k_rx_queue, skb_t, list);
+        list_del(&skb->list);
+        ne2k_rx_queue_len--;
+        ethernet_handle_rx(&ne2k_dev, skb);
+        skb_release(skb);
+    }
+
+    /* Pick up any packets that didn't fit in the queue */
+    ne2k_handle_rx();
+    return !list_empty(&ne2k_rx_queue);
+}
+
 /*
  * Begins transmission of a packet in the NE2k memory.
  * We will receive a tx interrupt when transmission finishes.
@@ -586,6 +622,7 @@ ne2k_init(void)
 {
     if (ne2k_reset()) {
         debugf("NE2000 device installed, reset complete\n");
+        defer_register(DEFER_NET_RX, ne2k_deliver_rx);
         irq_register_handler(IRQ_NE2K, ne2k_handle_irq);
         net_register_interface(&eth0);
     } else {
@@ -0,0 +1,143 @@
+#include "pagecache.h"
+#include "types.h"
+#include "debug.h"
+#include "list.h"
+#include "paging.h"
+#include "myalloc.h"
+
+/* Number of hash buckets in the page cache */
+#define PAGECACHE_NUM_BUCKETS 64
+
+/*
+ * A single cached page. Read-only pages of a program are fully
+ * determined by the file they come from and their virtual
+ * address, so every process running the same program can map
+ * the same frame. The cache holds one reference to the frame.
+ */
+typedef struct {
+    list_t list;
+    int inode_idx;
+    uintptr_t vaddr;
+    uintptr_t paddr;
+} pagecache_entry_t;
+
+/* Hash table of cached pages */
+static list_t pagecache_buckets[PAGECACHE_NUM_BUCKETS];
+
+/*
+ * Returns the hash bucket for the specified page.
+ */
+static list_t *
+pagecache_bucket(int inode_idx, uintptr_t vaddr)
+{
+    uint32_t hash = (uint32_t)inode_idx * 31 + vaddr / FRAME_SIZE;
+    return &pagecache_buckets[hash % PAGECACHE_NUM_BUCKETS];
+}
+
+/*
+ * Removes an entry from the cache, releasing its frame.
+ */
+static void
+pagecache_remove(pagecache_entry_t *entry)
+{
+    list_del(&entry->list);
+    paging_frame_free(entry->paddr);
+    free(entry);
+}
+
+/*
+ * Finds the frame holding the page at the specified address
+ * of the specified file. If found, a new reference to the
+ * frame is returned, which must be released with
+ * paging_frame_free(). Otherwise, returns 0.
+ */
+uintptr_t
+pagecache_get(int inode_idx, uintptr_t vaddr)
+{
+    list_t *bucket = pagecache_bucket(inode_idx, vaddr);
+    list_t *pos;
+    list_for_each(pos, bucket) {
+        pagecache_entry_t *entry = list_entry(pos, pagecache_entry_t, list);
+        if (entry->inode_idx == inode_idx && entry->vaddr == vaddr) {
+            paging_frame_retain(entry->paddr);
+            return entry->paddr;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Adds a page to the cache. The cache takes a new reference
+ * to the frame; the caller keeps its own. The page must not
+ * already be in the cache. If there is not enough memory,
+ * the page is simply not cached.
+ */
+void
+pagecache_add(int inode_idx, uintptr_t vaddr, uintptr_t paddr)
+{
+    pagecache_entry_t *entry = malloc(sizeof(pagecache_entry_t));
+    if (entry == NULL) {
+        debugf("Cannot allocate page cache entry\n");
+        return;
+    }
+
+    entry->inode_idx = inode_idx;
+    entry->vaddr = vaddr;
+    entry->paddr = paddr;
+    paging_frame_retain(paddr);
+    list_add(&entry->list, pagecache_bucket(inode_idx, vaddr));
+}
+
+/*
+ * Drops all cached pages of the specified file. This must be
+ * called whenever the file is modified or deleted. Processes
+ * that still have the pages mapped keep their reference.
+ */
+void
+pagecache_invalidate(int inode_idx)
+{
+    int i;
+    for (i = 0; i < PAGECACHE_NUM_BUCKETS; ++i) {
+        list_t *pos, *next;
+        list_for_each_safe(pos, next, &pagecache_buckets[i]) {
+            pagecache_entry_t *entry = list_entry(pos, pagecache_entry_t, list);
+            if (entry->inode_idx == inode_idx) {
+                pagecache_remove(entry);
+            }
+        }
+    }
+}
+
+/*
+ * Drops all cached pages that are not mapped by any process,
+ * freeing their frames. Returns the number of pages freed.
+ */
+int
+pagecache_shrink(void)
+{
+    int count = 0;
+    int i;
+    for (i = 0; i < PAGECACHE_NUM_BUCKETS; ++i) {
+        list_t *pos, *next;
+        list_for_each_safe(pos, next, &pagecache_buckets[i]) {
+            pagecache_entry_t *entry = list_entry(pos, pagecache_entry_t, list);
+            if (!paging_frame_is_shared(entry->paddr)) {
+                pagecache_remove(entry);
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+/*
+ * Initializes the page cache.
+ */
+void
+pagecache_init(void)
+{
+    int i;
+    for (i = 0; i < PAGECACHE_NUM_BUCKETS; ++i) {
+        list_init(&pagecache_buckets[i]);
+    }
+}
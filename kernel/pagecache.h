@@ -0,0 +1,25 @@
+#ifndef _PAGECACHE_H
+#define _PAGECACHE_H
+
+#include "types.h"
+
+#ifndef ASM
+
+/* Finds a cached page, returning its frame with a new reference */
+uintptr_t pagecache_get(int inode_idx, uintptr_t vaddr);
+
+/* Adds a page to the cache */
+void pagecache_add(int inode_idx, uintptr_t vaddr, uintptr_t paddr);
+
+/* Drops all cached pages for the specified inode */
+void pagecache_invalidate(int inode_idx);
+
+/* Drops all cached pages that are not currently mapped */
+int pagecache_shrink(void);
+
+/* Initializes the page cache */
+void pagecache_init(void);
+
+#endif /* ASM */
+
+#endif /* _PAGECACHE_H */
@@ -1,33 +1,46 @@
 #include "paging.h"
 #include "types.h"
+#include "multiboot.h"
 #include "debug.h"
 #include "string.h"
 #include "terminal.h"
-#include "bitmap.h"
+#include "math.h"
+#include "list.h"
 #include "filesys.h"
+#include "vm.h"
+#include "kthread.h"
+#include "scheduler.h"
 
 /* PDE size field values */
 #define SIZE_4KB 0
 #define SIZE_4MB 1
 
-/* Amount of physical memory present in the system (256MB) */
-#define MAX_RAM MB(256)
-#define MAX_PAGES (MAX_RAM / PAGE_SIZE)
+/*
+ * Maximum amount of physical memory supported. All RAM must be
+ * accessible through the physmap, so this is limited by its size.
+ */
+#define MAX_RAM (PHYSMAP_END - PHYSMAP_START)
+#define MAX_FRAMES (MAX_RAM / FRAME_SIZE)
+
+/* Multiboot memory map type for usable RAM */
+#define MMAP_TYPE_RAM 1
+
+/* Maximum number of usable memory regions we keep track of */
+#define MAX_RAM_REGIONS 16
 
-/* Structure for 4KB page table entry */
+/* Usable region of physical memory, [start, end) */
 typedef struct {
-    uint32_t present        : 1;
-    uint32_t write          : 1;
-    uint32_t user           : 1;
-    uint32_t write_through  : 1;
-    uint32_t cache_disabled : 1;
-    uint32_t accessed       : 1;
-    uint32_t dirty          : 1;
-    uint32_t page_attr_idx  : 1;
-    uint32_t global         : 1;
-    uint32_t avail          : 3;
-    uint32_t base_addr      : 20;
-} __packed pte_t;
+    uintptr_t start;
+    uintptr_t end;
+} ram_region_t;
+
+/*
+ * Usable RAM as reported by the bootloader, and the end
+ * of the highest region (i.e. the extent of the physmap).
+ */
+static ram_region_t ram_regions[MAX_RAM_REGIONS];
+static int num_ram_regions = 0;
+static uintptr_t ram_end = 0;
 
 /* Structure for 4KB page directory entry */
 typedef struct {
@@ -76,11 +89,55 @@ __aligned(KB(4))
 static pte_t page_table[1024];
 
 /*
- * We don't bother with free lists or any of that fancy stuff
- * in our page allocator. Just use a single flat bitmap with
- * one bit representing one page in the system.
+ * Physical memory is managed by a buddy allocator. Free memory
+ * is kept in blocks of 2^order contiguous 4KB frames, from a
+ * single frame up to an entire 4MB page, with one free list per
+ * order. The list nodes are stored in the free blocks themselves
+ * (accessed through the physmap), so the only other metadata is
+ * the order of each free block, indexed by its first frame.
+ */
+#define PAGE_ORDER 10
+#define NUM_ORDERS (PAGE_ORDER + 1)
+#define ORDER_NONE 0xff
+static list_t free_lists[NUM_ORDERS];
+static uint8_t free_order[MAX_FRAMES];
+
+/*
+ * Number of references to each allocated 4KB frame. Frames
+ * shared between address spaces after fork() have a refcount
+ * greater than one.
+ */
+static uint16_t frame_refcnt[MAX_FRAMES];
+
+/*
+ * Pool of frames that have already been filled with zeros.
+ * A low priority kernel thread refills it in the background,
+ * so that frames can be handed out by paging_frame_alloc_zeroed()
+ * without clearing them on the allocation path. Frames in
+ * the pool are allocated, with a reference count of 1.
  */
-static bitmap_define(allocated_pages, MAX_PAGES);
+#define ZERO_POOL_SIZE 256
+static uintptr_t zero_pool[ZERO_POOL_SIZE];
+static int zero_pool_count = 0;
+
+/* Number of frames zeroed each time the zeroing thread runs */
+#define ZERO_POOL_BATCH 8
+
+/* Kernel thread that refills the zeroed frame pool */
+static kthread_t zero_thread;
+
+/*
+ * State for batched TLB invalidations. While a batch is open,
+ * invalidations are recorded instead of being performed, and
+ * are all done at once when the batch is closed. If too many
+ * pages are invalidated, the entire TLB is flushed instead.
+ */
+#define TLB_BATCH_SIZE 16
+static int tlb_batch_depth = 0;
+static bool tlb_batch_flush = false;
+static bool tlb_batch_overflow = false;
+static uintptr_t tlb_batch_addrs[TLB_BATCH_SIZE];
+static int tlb_batch_count = 0;
 
 /*
  * Helpful macros to access page table stuff. Conventions:
@@ -97,11 +154,16 @@ static bitmap_define(allocated_pages, MAX_PAGES);
 #define DIR_TO_PDE_4KB(dir, addr) (&(dir)[TO_DIR_INDEX(addr)].dir_4kb)
 #define DIR_TO_PDE_4MB(dir, addr) (&(dir)[TO_DIR_INDEX(addr)].dir_4mb)
 #define TABLE_TO_PTE(table, addr) (&(table)[TO_TABLE_INDEX(addr)])
-#define PDE_TO_TABLE(pde) ((pte_t *)((pde)->base_addr << 12))
+#define PDE_TO_TABLE(pde) ((pte_t *)paging_phys_to_virt((pde)->base_addr << 12))
 #define PDE_TO_PTE(pde, addr) (TABLE_TO_PTE(PDE_TO_TABLE(pde), (addr)))
 #define PDE_4KB(addr) (DIR_TO_PDE_4KB(page_dir, (addr)))
 #define PDE_4MB(addr) (DIR_TO_PDE_4MB(page_dir, (addr)))
-#define PTE(addr) (PDE_TO_PTE(PDE_4KB(addr), (addr)))
+
+/*
+ * Accesses the static page table for the first 4MB of memory.
+ * This can be used before paging (and thus the physmap) is enabled.
+ */
+#define PTE(addr) (TABLE_TO_PTE(page_table, (addr)))
 
 /* Initializes the page directory for the first 4MB of memory */
 static void
@@ -113,7 +175,6 @@ paging_init_common(void)
     pde->user = 1; /* Needed for vidmap page */
     pde->size = SIZE_4KB;
     pde->base_addr = TO_4KB_BASE(page_table);
-    bitmap_set(allocated_pages, 0);
 }
 
 /* Initializes the page directory for the 4MB kernel page */
@@ -124,9 +185,9 @@ paging_init_kernel(void)
     pde->present = 1;
     pde->write = 1;
     pde->user = 0;
+    pde->global = 1;
     pde->size = SIZE_4MB;
     pde->base_addr = TO_4MB_BASE(KERNEL_PAGE_START);
-    bitmap_set(allocated_pages, 1);
 }
 
 /* Initializes the VGA text mode page */
@@ -137,6 +198,7 @@ paging_init_vga_text(void)
     pte->present = 1;
     pte->write = 1;
     pte->user = 0;
+    pte->global = 1;
     pte->base_addr = TO_4KB_BASE(VGA_TEXT_PAGE_START);
 }
 
@@ -150,10 +212,32 @@ paging_init_vga_font(void)
         pte->present = 1;
         pte->write = 1;
         pte->user = 0;
+        pte->global = 1;
         pte->base_addr = TO_4KB_BASE(addr);
     }
 }
 
+/*
+ * Initializes the physmap, which maps all physical memory
+ * into the kernel's address space so that individual 4KB
+ * frames (e.g. user pages and page tables) can be accessed
+ * without modifying any mappings.
+ */
+static void
+paging_init_physmap(void)
+{
+    uintptr_t paddr;
+    for (paddr = 0; paddr < ram_end; paddr += MB(4)) {
+        pde_4mb_t *pde = PDE_4MB(PHYSMAP_START + paddr);
+        pde->present = 1;
+        pde->write = 1;
+        pde->user = 0;
+        pde->global = 1;
+        pde->size = SIZE_4MB;
+        pde->base_addr = TO_4MB_BASE(paddr);
+    }
+}
+
 /* Initializes the VBE framebuffer pages */
 static void
 paging_init_vga_vbe(void)
@@ -193,24 +277,39 @@ paging_init_registers(void)
         "orl %0, %%eax;"
         "movl %%eax, %%cr3;"
 
-        /* Enable 4MB pages */
+        /*
+         * Enable 4MB pages and global pages. Kernel mappings are
+         * global, so they are not flushed when CR3 is reloaded.
+         */
         "movl %%cr4, %%eax;"
-        "orl $0x00000010, %%eax;"
+        "orl $0x00000090, %%eax;"
         "movl %%eax, %%cr4;"
 
-        /* Enable paging (this must come last!) */
+        /*
+         * Enable paging (this must come last!) and write protection,
+         * so that kernel writes to copy-on-write pages also fault.
+         */
         "movl %%cr0, %%eax;"
-        "orl $0x80000000, %%eax;"
+        "orl $0x80010000, %%eax;"
         "movl %%eax, %%cr0;"
         :
         : "g"(&page_dir)
         : "eax", "memory", "cc");
 }
 
-/* Flushes the TLB */
-static void
+/*
+ * Flushes all non-global entries from the TLB (i.e. all
+ * user mappings). If a batch is open, the flush is deferred
+ * until the batch is closed.
+ */
+void
 paging_flush_tlb(void)
 {
+    if (tlb_batch_depth > 0) {
+        tlb_batch_flush = true;
+        return;
+    }
+
     asm volatile(
         "movl %%cr3, %%eax;"
         "movl %%eax, %%cr3;"
@@ -219,14 +318,194 @@ paging_flush_tlb(void)
         : "eax", "memory");
 }
 
-/* Initializes all initial page tables and enables paging. */
+/*
+ * Flushes the entire TLB, including global entries, by
+ * toggling CR4.PGE.
+ */
+static void
+paging_flush_tlb_global(void)
+{
+    asm volatile(
+        "movl %%cr4, %%eax;"
+        "andl $0xffffff7f, %%eax;"
+        "movl %%eax, %%cr4;"
+        "orl $0x00000080, %%eax;"
+        "movl %%eax, %%cr4;"
+        :
+        :
+        : "eax", "memory");
+}
+
+/*
+ * Invalidates the TLB entry for the page containing the
+ * specified virtual address. This must be used when changing
+ * a global (kernel) mapping. If a batch is open, the
+ * invalidation is deferred until the batch is closed.
+ */
+void
+paging_invalidate_page(uintptr_t vaddr)
+{
+    if (tlb_batch_depth > 0) {
+        if (tlb_batch_count < TLB_BATCH_SIZE) {
+            tlb_batch_addrs[tlb_batch_count++] = vaddr;
+        } else {
+            tlb_batch_overflow = true;
+        }
+        return;
+    }
+
+    asm volatile("invlpg (%0)" : : "r"(vaddr) : "memory");
+}
+
+/*
+ * Begins a batch of page table updates. TLB invalidations
+ * are deferred until the matching paging_end_batch() call,
+ * at which point the TLB is flushed at most once. Batches
+ * may be nested.
+ */
+void
+paging_begin_batch(void)
+{
+    tlb_batch_depth++;
+}
+
+/*
+ * Ends a batch of page table updates, performing all of
+ * the TLB invalidations that were requested within it.
+ */
+void
+paging_end_batch(void)
+{
+    assert(tlb_batch_depth > 0);
+    if (--tlb_batch_depth > 0) {
+        return;
+    }
+
+    if (tlb_batch_overflow) {
+        paging_flush_tlb_global();
+    } else {
+        if (tlb_batch_flush) {
+            paging_flush_tlb();
+        }
+
+        /* Global entries are not flushed by paging_flush_tlb() */
+        int i;
+        for (i = 0; i < tlb_batch_count; ++i) {
+            paging_invalidate_page(tlb_batch_addrs[i]);
+        }
+    }
+
+    tlb_batch_flush = false;
+    tlb_batch_overflow = false;
+    tlb_batch_count = 0;
+}
+
+/*
+ * Records a region of usable RAM. Memory below the end of the
+ * kernel page is never handed to the allocator, and anything
+ * that would not fit in the physmap is ignored.
+ */
+static void
+paging_add_ram_region(uint64_t start, uint64_t end)
+{
+    start = max(start, (uint64_t)KERNEL_PAGE_END);
+    end = min(end, (uint64_t)MAX_RAM);
+    if (start >= end) {
+        return;
+    }
+
+    if (num_ram_regions == MAX_RAM_REGIONS) {
+        debugf(
+            "Too many memory regions, ignoring 0x%08x-0x%08x\n",
+            (uintptr_t)start,
+            (uintptr_t)end);
+        return;
+    }
+
+    ram_region_t *region = &ram_regions[num_ram_regions++];
+    region->start = round_up((uintptr_t)start, FRAME_SIZE);
+    region->end = round_down((uintptr_t)end, FRAME_SIZE);
+    ram_end = max(ram_end, region->end);
+}
+
+/*
+ * Finds the usable RAM in the system from the memory map
+ * provided by the bootloader. If there is no memory map,
+ * falls back to the size of upper memory. This must be
+ * called before paging is enabled, since the multiboot
+ * structures live in low memory.
+ */
+static void
+paging_init_ram(multiboot_info_t *mbi)
+{
+    if (mbi->flags & MULTIBOOT_INFO_MMAP) {
+        uintptr_t addr = mbi->mmap_addr;
+        while (addr < mbi->mmap_addr + mbi->mmap_length) {
+            memory_map_t *mmap = (memory_map_t *)addr;
+            if (mmap->type == MMAP_TYPE_RAM) {
+                uint64_t start = ((uint64_t)mmap->base_addr_high << 32) | mmap->base_addr_low;
+                uint64_t length = ((uint64_t)mmap->length_high << 32) | mmap->length_low;
+                paging_add_ram_region(start, start + length);
+            }
+            addr += mmap->size + sizeof(mmap->size);
+        }
+    } else if (mbi->flags & MULTIBOOT_INFO_MEMORY) {
+        paging_add_ram_region(MB(1), MB(1) + (uint64_t)KB(mbi->mem_upper));
+    }
+
+    if (num_ram_regions == 0) {
+        panic("No usable memory found\n");
+    }
+}
+
+/*
+ * Initializes the page allocator, marking all usable memory
+ * above the kernel page as free. This must be called after
+ * paging is enabled, since the free lists are accessed through
+ * the physmap.
+ */
+static void
+paging_init_allocator(void)
+{
+    int i;
+    for (i = 0; i < NUM_ORDERS; ++i) {
+        list_init(&free_lists[i]);
+    }
+    memset(free_order, ORDER_NONE, sizeof(free_order));
+
+    /*
+     * Free each region in the largest aligned blocks that fit,
+     * so that holes in the memory map are never allocated.
+     */
+    for (i = 0; i < num_ram_regions; ++i) {
+        uintptr_t paddr = ram_regions[i].start;
+        while (paddr < ram_regions[i].end) {
+            int order = PAGE_ORDER;
+            while (paddr % (FRAME_SIZE << order) != 0 ||
+                   paddr + (FRAME_SIZE << order) > ram_regions[i].end) {
+                order--;
+            }
+            paging_block_free(paddr, order);
+            paddr += FRAME_SIZE << order;
+        }
+    }
+}
+
+/*
+ * Initializes all initial page tables and enables paging.
+ * The amount of memory available is determined from the
+ * multiboot information structure.
+ */
 void
-paging_init(void)
+paging_init(multiboot_info_t *mbi)
 {
     /* Ensure page table arrays are 4096-byte aligned */
     assert(((uintptr_t)page_dir   & 0xfff) == 0);
     assert(((uintptr_t)page_table & 0xfff) == 0);
 
+    /* Find out how much memory we have to work with */
+    paging_init_ram(mbi);
+
     /* Initialize static page table entries */
     paging_init_common();
     paging_init_kernel();
@@ -234,9 +513,99 @@ paging_init(void)
     paging_init_vga_font();
     paging_init_vga_vbe();
     paging_init_vidmap();
+    paging_init_physmap();
 
     /* Set control registers */
     paging_init_registers();
+
+    /* Hand the remaining memory to the page allocator */
+    paging_init_allocator();
+}
+
+/*
+ * Adds a block to the free list for the specified order.
+ */
+static void
+paging_buddy_push(int ffn, int order)
+{
+    list_t *node = paging_phys_to_virt(ffn * FRAME_SIZE);
+    list_add(node, &free_lists[order]);
+    free_order[ffn] = order;
+}
+
+/*
+ * Removes a block from the free list for the specified order.
+ */
+static void
+paging_buddy_remove(int ffn, int order)
+{
+    assert(free_order[ffn] == order);
+    list_t *node = paging_phys_to_virt(ffn * FRAME_SIZE);
+    list_del(node);
+    free_order[ffn] = ORDER_NONE;
+}
+
+/*
+ * Allocates a block of 2^order contiguous 4KB frames, aligned
+ * to its size, and returns its physical address. If no block
+ * of that size is available, returns 0. The block is neither
+ * mapped nor initialized.
+ */
+uintptr_t
+paging_block_alloc(int order)
+{
+    assert(order >= 0 && order <= PAGE_ORDER);
+
+    /* Find the smallest free block that is large enough */
+    int i;
+    for (i = order; i <= PAGE_ORDER; ++i) {
+        if (!list_empty(&free_lists[i])) {
+            break;
+        }
+    }
+    if (i > PAGE_ORDER) {
+        return 0;
+    }
+
+    uintptr_t vaddr = (uintptr_t)free_lists[i].next;
+    int ffn = (vaddr - PHYSMAP_START) / FRAME_SIZE;
+    paging_buddy_remove(ffn, i);
+
+    /* Split it in half until it's the right size */
+    while (i > order) {
+        i--;
+        paging_buddy_push(ffn + (1 << i), i);
+    }
+
+    return ffn * FRAME_SIZE;
+}
+
+/*
+ * Frees a block obtained from paging_block_alloc(). order
+ * must be the same as when the block was allocated. The block
+ * is merged with its buddy for as long as the buddy is free.
+ */
+void
+paging_block_free(uintptr_t paddr, int order)
+{
+    int ffn = paddr / FRAME_SIZE;
+    assert(paddr != 0 && paddr < ram_end);
+    assert(order >= 0 && order <= PAGE_ORDER);
+    assert(ffn % (1 << order) == 0);
+    assert(free_order[ffn] == ORDER_NONE);
+
+    while (order < PAGE_ORDER) {
+        int buddy = ffn ^ (1 << order);
+        if (free_order[buddy] != order) {
+            break;
+        }
+
+        paging_buddy_remove(buddy, order);
+        ffn &= ~(1 << order);
+        order++;
+    }
+
+    paging_buddy_push(ffn, order);
 }
 
 /*
@@ -249,16 +618,7 @@ paging_init(void)
 uintptr_t
 paging_page_alloc(void)
 {
-    /* Find a free page... */
-    int pfn = bitmap_find_zero(allocated_pages, MAX_PAGES);
-    if (pfn >= MAX_PAGES) {
-        return -1;
-    }
-
-    /* ... and mark it as allocated. */
-    bitmap_set(allocated_pages, pfn);
-    uintptr_t paddr = pfn * PAGE_SIZE;
-    return paddr;
+    return paging_block_alloc(PAGE_ORDER);
 }
 
 /*
@@ -267,16 +627,16 @@ paging_page_alloc(void)
 void
 paging_page_free(uintptr_t paddr)
 {
-    assert(paddr != 0);
-    int pfn = paddr / PAGE_SIZE;
-    assert(bitmap_get(allocated_pages, pfn));
-    bitmap_clear(allocated_pages, pfn);
+    assert(paddr % PAGE_SIZE == 0);
+    paging_block_free(paddr, PAGE_ORDER);
 }
 
 /*
  * Modifies the page tables to map one page (of size PAGE_SIZE)
  * from the specified virtual address to the specified physical
- * address. Flushes the TLB.
+ * address. Kernel pages are mapped as global. The TLB entry is
+ * only invalidated if the page was previously mapped, since
+ * non-present entries are never cached.
  */
 void
 paging_page_map(uintptr_t vaddr, uintptr_t paddr, bool user)
@@ -284,17 +644,21 @@ paging_page_map(uintptr_t vaddr, uintptr_t paddr, bool user)
     assert(PAGE_SIZE == MB(4));
 
     pde_4mb_t *entry = PDE_4MB(vaddr);
+    bool was_present = entry->present;
     entry->present = 1;
     entry->write = 1;
     entry->user = user;
+    entry->global = !user;
     entry->size = SIZE_4MB;
     entry->base_addr = TO_4MB_BASE(paddr);
-    paging_flush_tlb();
+    if (was_present) {
+        paging_invalidate_page(vaddr);
+    }
 }
 
 /*
- * Modifies the page tables to unmap the specified page. Flushes
- * the TLB.
+ * Modifies the page tables to unmap the specified page, and
+ * invalidates its TLB entry.
  */
 void
 paging_page_unmap(uintptr_t vaddr)
@@ -303,29 +667,180 @@ paging_page_unmap(uintptr_t vaddr)
 
     pde_4mb_t *entry = PDE_4MB(vaddr);
     entry->present = 0;
-    paging_flush_tlb();
+    paging_invalidate_page(vaddr);
+}
+
+/*
+ * Takes a frame from the zeroed frame pool, which must not
+ * be empty, and wakes the zeroing thread to replace it.
+ */
+static uintptr_t
+paging_zero_pool_take(void)
+{
+    assert(zero_pool_count > 0);
+    if (zero_thread.pcb != NULL) {
+        kthread_wake(&zero_thread);
+    }
+    return zero_pool[--zero_pool_count];
+}
+
+/*
+ * Allocates a new 4KB frame and returns its physical address,
+ * or 0 if there is no free memory. The frame contents are not
+ * initialized. The frame starts with a reference count of 1.
+ */
+uintptr_t
+paging_frame_alloc(void)
+{
+    uintptr_t paddr = paging_block_alloc(0);
+    if (paddr != 0) {
+        frame_refcnt[paddr / FRAME_SIZE] = 1;
+    } else if (zero_pool_count > 0) {
+        /* Out of memory, fall back to the zeroed frames */
+        paddr = paging_zero_pool_take();
+    }
+    return paddr;
+}
+
+/*
+ * Same as paging_frame_alloc(), but the frame is filled with
+ * zeros. Frames are taken from the pre-zeroed pool if possible.
+ */
+uintptr_t
+paging_frame_alloc_zeroed(void)
+{
+    if (zero_pool_count > 0) {
+        return paging_zero_pool_take();
+    }
+
+    uintptr_t paddr = paging_frame_alloc();
+    if (paddr != 0) {
+        memset(paging_phys_to_virt(paddr), 0, FRAME_SIZE);
+    }
+    return paddr;
+}
+
+/*
+ * Zeroes a single free frame and adds it to the pool of
+ * zeroed frames. Returns false if the pool is already full
+ * or there is no free memory.
+ */
+static bool
+paging_zero_pool_refill(void)
+{
+    if (zero_pool_count == ZERO_POOL_SIZE) {
+        return false;
+    }
+
+    uintptr_t paddr = paging_block_alloc(0);
+    if (paddr == 0) {
+        return false;
+    }
+
+    frame_refcnt[paddr / FRAME_SIZE] = 1;
+    memset(paging_phys_to_virt(paddr), 0, FRAME_SIZE);
+    zero_pool[zero_pool_count++] = paddr;
+    return true;
+}
+
+/*
+ * Work function of the zeroing thread. Zeroes a batch of
+ * frames at a time, so that it yields to other processes
+ * regularly. Returns whether the pool still needs refilling.
+ */
+static bool
+paging_zero_worker(void *arg)
+{
+    int i;
+    for (i = 0; i < ZERO_POOL_BATCH; ++i) {
+        if (!paging_zero_pool_refill()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Starts the kernel thread that zeroes free frames. It runs
+ * at the lowest priority, since the pool is only an
+ * optimization.
+ */
+void
+paging_zero_init(void)
+{
+    kthread_create(&zero_thread, "zero", paging_zero_worker, NULL, NICE_MAX);
+}
+
+/*
+ * Increments the reference count of a frame obtained from
+ * paging_frame_alloc(). Returns paddr for convenience.
+ */
+uintptr_t
+paging_frame_retain(uintptr_t paddr)
+{
+    int ffn = paddr / FRAME_SIZE;
+    assert(paddr != 0);
+    assert(frame_refcnt[ffn] > 0);
+    assert(frame_refcnt[ffn] < 0xffff);
+    frame_refcnt[ffn]++;
+    return paddr;
 }
 
 /*
- * Copies the contents of the user page to the specified physical
- * address. This does not clobber any page mappings.
+ * Decrements the reference count of a frame obtained from
+ * paging_frame_alloc(), freeing it if it reaches zero.
  */
 void
-paging_clone_user_page(uintptr_t dest_paddr)
+paging_frame_free(uintptr_t paddr)
+{
+    int ffn = paddr / FRAME_SIZE;
+    assert(paddr != 0);
+    assert(frame_refcnt[ffn] > 0);
+    if (--frame_refcnt[ffn] == 0) {
+        paging_block_free(paddr, 0);
+    }
+}
+
+/*
+ * Returns whether the specified frame is referenced by more
+ * than one owner.
+ */
+bool
+paging_frame_is_shared(uintptr_t paddr)
+{
+    int ffn = paddr / FRAME_SIZE;
+    assert(frame_refcnt[ffn] > 0);
+    return frame_refcnt[ffn] > 1;
+}
+
+/*
+ * Returns a pointer through which the specified physical
+ * address can be accessed by the kernel.
+ */
+void *
+paging_phys_to_virt(uintptr_t paddr)
 {
-    paging_page_map(TEMP_PAGE_START, dest_paddr, false);
-    memcpy((void *)TEMP_PAGE_START, (const void *)USER_PAGE_START, MB(4));
-    paging_page_unmap(TEMP_PAGE_START);
+    assert(paddr < ram_end);
+    return (void *)(PHYSMAP_START + paddr);
 }
 
 /*
- * Updates the user page to point to the specified physical
- * address.
+ * Points the page directory entry covering the specified user
+ * virtual address to a 4KB page table, or marks it as not present
+ * if table_paddr is 0. Does not flush the TLB; the caller must
+ * call paging_flush_tlb() after updating all page tables.
  */
 void
-paging_map_user_page(uintptr_t paddr)
+paging_set_user_table(uintptr_t vaddr, uintptr_t table_paddr)
 {
-    paging_page_map(USER_PAGE_START, paddr, true);
+    assert(vaddr >= USER_PAGE_START && vaddr < USER_MMAP_END);
+
+    pde_4kb_t *pde = PDE_4KB(vaddr);
+    pde->present = (table_paddr != 0) ? 1 : 0;
+    pde->write = 1;
+    pde->user = 1;
+    pde->size = SIZE_4KB;
+    pde->base_addr = TO_4KB_BASE(table_paddr);
 }
 
 /*
@@ -338,7 +853,7 @@ paging_update_vidmap_page(uintptr_t paddr, bool present)
     pte_t *pte = PTE(VIDMAP_PAGE_START);
     pte->present = present ? 1 : 0;
     pte->base_addr = TO_4KB_BASE(paddr);
-    paging_flush_tlb();
+    paging_invalidate_page(VIDMAP_PAGE_START);
 }
 
 /*
@@ -351,17 +866,18 @@ paging_update_vbe_page(bool present)
     for (addr = VGA_VBE_PAGE_START; addr < VGA_VBE_PAGE_END; addr += MB(4)) {
         pde_4mb_t *pde = PDE_4MB(addr);
         pde->present = present ? 1 : 0;
+        paging_invalidate_page(addr);
     }
-    paging_flush_tlb();
 }
 
 /*
- * Returns whether a single byte access would be valid.
- * addr should point to some address to check on input. On output,
- * it will point to the next page that may need to be checked.
+ * Returns whether a single byte access would be valid with
+ * the current page mappings. addr should point to some address
+ * to check on input. On output, it will point to the next page
+ * that may need to be checked.
  */
 static bool
-is_page_accessible(uintptr_t *addr, bool user, bool write)
+is_page_present(uintptr_t *addr, bool user, bool write)
 {
     /* Access page info through the directory */
     pde_4kb_t *pde = PDE_4KB(*addr);
@@ -385,6 +901,27 @@ is_page_accessible(uintptr_t *addr, bool user, bool write)
     return true;
 }
 
+/*
+ * Returns whether a single byte access would be valid. User
+ * memory that is demand-paged or copy-on-write is faulted in
+ * if necessary. Same semantics for addr as is_page_present().
+ */
+static bool
+is_page_accessible(uintptr_t *addr, bool user, bool write)
+{
+    uintptr_t next = *addr;
+    if (is_page_present(&next, user, write)) {
+        *addr = next;
+        return true;
+    }
+
+    if (!vm_handle_fault(*addr, write)) {
+        return false;
+    }
+
+    return is_page_present(addr, user, write);
+}
+
 /*
  * Checks whether a memory access would be valid.
  * That is, this function will return true iff accessing
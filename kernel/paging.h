@@ -2,11 +2,13 @@
 #define _PAGING_H
 
 #include "types.h"
+#include "multiboot.h"
 
 #define KB(x) ((x) * 1024)
 #define MB(x) ((x) * 1024 * 1024)
 
 #define PAGE_SIZE MB(4)
+#define FRAME_SIZE KB(4)
 
 #define VGA_FONT_PAGE_START 0x000A0000U
 #define VGA_FONT_PAGE_END   0x000B0000U
@@ -21,10 +23,7 @@
 #define KERNEL_PAGE_END     0x00800000U
 
 #define KERNEL_HEAP_START   0x00800000U
-#define KERNEL_HEAP_END     0x07C00000U
-
-#define TEMP_PAGE_START     0x07C00000U
-#define TEMP_PAGE_END       0x08000000U
+#define KERNEL_HEAP_END     0x08000000U
 
 #define USER_PAGE_START     0x08000000U
 #define USER_PAGE_END       0x08400000U
@@ -32,13 +31,40 @@
 #define USER_HEAP_START     0x08400000U
 #define USER_HEAP_END       0x10000000U
 
+#define USER_MMAP_START     0x10000000U
+#define USER_MMAP_END       0x20000000U
+
+#define PHYSMAP_START       0xC0000000U
+#define PHYSMAP_END         0xE0000000U
+
 #define VGA_VBE_PAGE_START  0xE0000000U
 #define VGA_VBE_PAGE_END    0xE0800000U
 
 #ifndef ASM
 
+/* Structure for 4KB page table entry */
+typedef struct {
+    uint32_t present        : 1;
+    uint32_t write          : 1;
+    uint32_t user           : 1;
+    uint32_t write_through  : 1;
+    uint32_t cache_disabled : 1;
+    uint32_t accessed       : 1;
+    uint32_t dirty          : 1;
+    uint32_t page_attr_idx  : 1;
+    uint32_t global         : 1;
+    uint32_t avail          : 3;
+    uint32_t base_addr      : 20;
+} __packed pte_t;
+
 /* Initializes paging */
-void paging_init(void);
+void paging_init(multiboot_info_t *mbi);
+
+/* Allocates a block of 2^order 4KB frames without mapping it */
+uintptr_t paging_block_alloc(int order);
+
+/* Deallocates a block of frames without unmapping it */
+void paging_block_free(uintptr_t paddr, int order);
 
 /* Allocates a page without mapping it */
 uintptr_t paging_page_alloc(void);
@@ -52,14 +78,39 @@ void paging_page_map(uintptr_t vaddr, uintptr_t paddr, bool user);
 /* Unmaps a page from memory */
 void paging_page_unmap(uintptr_t vaddr);
 
-/* Loads a program into the user page */
-uint32_t paging_load_user_page(int inode_idx, uintptr_t paddr);
+/* Allocates a 4KB frame without mapping it */
+uintptr_t paging_frame_alloc(void);
+
+/* Allocates a zero-filled 4KB frame without mapping it */
+uintptr_t paging_frame_alloc_zeroed(void);
+
+/* Starts the thread that zeroes frames for paging_frame_alloc_zeroed() */
+void paging_zero_init(void);
+
+/* Adds a reference to an allocated 4KB frame */
+uintptr_t paging_frame_retain(uintptr_t paddr);
+
+/* Drops a reference to a 4KB frame */
+void paging_frame_free(uintptr_t paddr);
+
+/* Checks if a 4KB frame has more than one reference */
+bool paging_frame_is_shared(uintptr_t paddr);
+
+/* Returns the kernel virtual address of a physical address */
+void *paging_phys_to_virt(uintptr_t paddr);
+
+/* Installs a page table for part of the user address space */
+void paging_set_user_table(uintptr_t vaddr, uintptr_t table_paddr);
+
+/* Flushes all user mappings from the TLB */
+void paging_flush_tlb(void);
 
-/* Clones an existing user page */
-void paging_clone_user_page(uintptr_t dest_paddr);
+/* Invalidates a single page in the TLB */
+void paging_invalidate_page(uintptr_t vaddr);
 
-/* Updates the user page */
-void paging_map_user_page(uintptr_t paddr);
+/* Defers TLB invalidations until the end of the batch */
+void paging_begin_batch(void);
+void paging_end_batch(void);
 
 /* Updates the vidmap page to point to the specified address */
 void paging_update_vidmap_page(uintptr_t paddr, bool present);
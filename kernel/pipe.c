@@ -72,7 +72,7 @@ pipe_read(file_obj_t *file, void *buf, int nbytes)
     pipe_state_t *pipe = (pipe_state_t *)file->private;
     assert(pipe != NULL);
 
-    nbytes = WAIT_INTERRUPTIBLE(
+    nbytes = WAIT_INTERRUPTIBLE_EXCLUSIVE(
         pipe_get_readable_bytes(pipe, nbytes),
         &pipe->read_queue,
         file->nonblocking);
@@ -104,8 +104,13 @@ pipe_read(file_obj_t *file, void *buf, int nbytes)
         pipe->tail = (pipe->tail + this_read) % PIPE_SIZE;
     } while (nbytes > 0);
 
-    /* Buffer should have some space now, wake writers */
-    wait_queue_wake(&pipe->write_queue);
+    /* Buffer should have some space now, wake a writer */
+    wait_queue_wake_one(&pipe->write_queue);
+
+    /* If we left some data behind, pass it on to the next reader */
+    if (pipe_get_readable_bytes(pipe, 1) > 0) {
+        wait_queue_wake_one(&pipe->read_queue);
+    }
 
     /* Return number of bytes read (unless no copies succeeded) */
     if (total_read == 0) {
@@ -160,7 +165,7 @@ pipe_write(file_obj_t *file, const void *buf, int nbytes)
     pipe_state_t *pipe = (pipe_state_t *)file->private;
     assert(pipe != NULL);
 
-    nbytes = WAIT_INTERRUPTIBLE(
+    nbytes = WAIT_INTERRUPTIBLE_EXCLUSIVE(
         pipe_get_writable_bytes(pipe, nbytes),
         &pipe->write_queue,
         file->nonblocking);
@@ -189,8 +194,13 @@ pipe_write(file_obj_t *file, const void *buf, int nbytes)
         pipe->head = (pipe->head + this_write) % PIPE_SIZE;
     } while (nbytes > 0);
 
-    /* Now that we have some data in the pipe, wake up readers */
-    wait_queue_wake(&pipe->read_queue);
+    /* Now that we have some data in the pipe, wake up a reader */
+    wait_queue_wake_one(&pipe->read_queue);
+
+    /* If there is still space left, pass it on to the next writer */
+    if (pipe_get_writable_bytes(pipe, 1) > 0) {
+        wait_queue_wake_one(&pipe->write_queue);
+    }
 
     if (total_write == 0) {
         return -1;
@@ -1,6 +1,7 @@
 #include "pit.h"
 #include "types.h"
 #include "debug.h"
+#include "math.h"
 #include "portio.h"
 #include "irq.h"
 #include "scheduler.h"
@@ -9,11 +10,16 @@
 /* Internal frequency of the PIT */
 #define PIT_FREQ 1193182
 
-/* Use a value such that freq/divisor is ~100Hz */
-#define PIT_DIVISOR 11932
+/* Length of a scheduler timeslice in milliseconds */
+#define PIT_TICK_MS 10
 
-/* Number of milliseconds that elapse per interrupt */
-#define PIT_MS_PER_IRQ (1000 * PIT_DIVISOR / PIT_FREQ)
+/*
+ * Longest interval that the PIT can be programmed for, in cycles
+ * and in (whole) milliseconds. This is ~54ms; an idle system
+ * will still get an interrupt this often.
+ */
+#define PIT_MAX_CYCLES 65535
+#define PIT_MAX_MS (1000 * PIT_MAX_CYCLES / PIT_FREQ)
 
 /* PIT IO ports */
 #define PIT_PORT_DATA_0 0x40
@@ -24,46 +30,136 @@
 /* PIT command bits */
 #define PIT_CMD_CHANNEL_0 0x00 /* Select channel 0 */
 #define PIT_CMD_ACCESS_HL 0x30 /* Access high and low bytes */
-#define PIT_CMD_OPMODE_2  0x04 /* Rate generator mode */
+#define PIT_CMD_OPMODE_0  0x00 /* Interrupt on terminal count mode */
 #define PIT_CMD_BINARY    0x00 /* Use binary mode */
+#define PIT_CMD_READBACK  0xC2 /* Latch count and status of channel 0 */
+
+/* PIT read-back status bits */
+#define PIT_STATUS_OUT        0x80 /* Output pin is high (count expired) */
+#define PIT_STATUS_NULL_COUNT 0x40 /* New count not loaded yet */
+
+/*
+ * Monotonic time at which the PIT was last programmed, in
+ * milliseconds. The fractional part is kept separately in
+ * units of 1/PIT_FREQ milliseconds to avoid drift.
+ */
+static volatile uint32_t pit_base_ms = 0;
+static volatile uint32_t pit_base_frac = 0;
+
+/* Number of cycles that the PIT was last programmed with */
+static int pit_cycles = 0;
+
+/* Monotonic time at which the next interrupt is due */
+static int pit_deadline = 0;
+
+/*
+ * Monotonic time of the next scheduler tick, or -1 if the
+ * scheduler does not need one (fewer than two processes
+ * are runnable).
+ */
+static int pit_next_tick = -1;
 
 /*
- * Global counter used for monotonic time.
+ * Returns the number of cycles that have elapsed since the
+ * PIT was last programmed. After the count expires, the
+ * counter wraps around and keeps counting down, so this
+ * remains accurate for another ~54ms if the interrupt is
+ * delayed.
  */
-static volatile uint32_t pit_counter = 0;
+static int
+pit_elapsed_cycles(void)
+{
+    if (pit_cycles == 0) {
+        return 0;
+    }
+
+    outb(PIT_CMD_READBACK, PIT_PORT_CMD);
+    uint8_t status = inb(PIT_PORT_DATA_0);
+    int count = inb(PIT_PORT_DATA_0);
+    count |= inb(PIT_PORT_DATA_0) << 8;
+
+    if (status & PIT_STATUS_OUT) {
+        return pit_cycles + ((0x10000 - count) & 0xffff);
+    } else if (status & PIT_STATUS_NULL_COUNT) {
+        return 0;
+    } else {
+        return pit_cycles - min(count, pit_cycles);
+    }
+}
 
 /*
- * Sets the interrupt frequency of the PIT. The argument
- * is the number of PIT cycles per interrupt.
+ * Programs the PIT to fire a single interrupt at the specified
+ * monotonic time, or as late as possible if that is too far
+ * in the future. Time elapsed under the previous count is
+ * folded into the base time first.
  */
 static void
-pit_set_divisor(int divisor)
+pit_program(int when)
 {
-    assert(divisor >= 1 && divisor <= 65536);
+    uint32_t frac = pit_base_frac + pit_elapsed_cycles() * 1000;
+    pit_base_ms += frac / PIT_FREQ;
+    pit_base_frac = frac % PIT_FREQ;
+
+    /* Round up, so that the clock has reached when by the interrupt */
+    int delay = clamp((int)(when - pit_base_ms), 0, PIT_MAX_MS);
+    int cycles = div_round_up(delay * PIT_FREQ - (int)pit_base_frac, 1000);
+    cycles = clamp(cycles, 1, PIT_MAX_CYCLES);
+    pit_cycles = cycles;
+    pit_deadline = pit_base_ms + delay;
 
-    /* Set PIT operation mode */
     uint8_t cmd = 0;
     cmd |= PIT_CMD_CHANNEL_0;
     cmd |= PIT_CMD_ACCESS_HL;
-    cmd |= PIT_CMD_OPMODE_2;
+    cmd |= PIT_CMD_OPMODE_0;
     cmd |= PIT_CMD_BINARY;
     outb(cmd, PIT_PORT_CMD);
+    outb((cycles >> 0) & 0xff, PIT_PORT_DATA_0);
+    outb((cycles >> 8) & 0xff, PIT_PORT_DATA_0);
+}
 
-    /* Write divisor value. 65536 is naturally masked to 0. */
-    outb((divisor >> 0) & 0xff, PIT_PORT_DATA_0);
-    outb((divisor >> 8) & 0xff, PIT_PORT_DATA_0);
+/*
+ * Programs the PIT for the next event: the earliest timer
+ * expiry or the next scheduler tick, whichever is sooner.
+ */
+static void
+pit_program_next(void)
+{
+    int when = pit_monotime() + PIT_MAX_MS;
+
+    int expiry = timer_next_expiry();
+    if (expiry >= 0) {
+        when = min(when, expiry);
+    }
+
+    if (pit_next_tick >= 0) {
+        when = min(when, pit_next_tick);
+    }
+
+    pit_program(when);
 }
 
 /*
- * PIT IRQ handler. Updates timers and yields the current
- * process's timeslice.
+ * PIT IRQ handler. Runs expired timers, lets the scheduler
+ * preempt the current process if a timeslice has ended, and
+ * programs the PIT for the next event.
  */
 static void
 pit_handle_irq(void)
 {
-    uint32_t now = ++pit_counter;
-    timer_tick(PIT_MS_PER_IRQ * now);
-    scheduler_yield();
+    int now = pit_monotime();
+    timer_tick(now);
+
+    bool tick = pit_next_tick >= 0 && now >= pit_next_tick;
+    if (tick) {
+        pit_next_tick = scheduler_needs_tick() ? now + PIT_TICK_MS : -1;
+    }
+
+    /* Must come before scheduler_tick(), which may switch processes */
+    pit_program_next();
+
+    if (tick) {
+        scheduler_tick();
+    }
 }
 
 /*
@@ -74,16 +170,42 @@ pit_handle_irq(void)
 __cdecl int
 pit_monotime(void)
 {
-    return PIT_MS_PER_IRQ * pit_counter;
+    return pit_base_ms + (pit_base_frac + pit_elapsed_cycles() * 1000) / PIT_FREQ;
+}
+
+/*
+ * Ensures that a timer interrupt will occur no later than
+ * the specified monotonic time.
+ */
+void
+pit_set_deadline(int when)
+{
+    if (when < pit_deadline) {
+        pit_program(when);
+    }
+}
+
+/*
+ * Ensures that a scheduler tick will occur within one
+ * timeslice. Called when the scheduler goes from one to
+ * multiple runnable processes.
+ */
+void
+pit_request_tick(void)
+{
+    if (pit_next_tick < 0) {
+        pit_next_tick = pit_monotime() + PIT_TICK_MS;
+        pit_set_deadline(pit_next_tick);
+    }
 }
 
 /*
- * Initializes the PIT. Sets the frequency and registers
- * the IRQ handler.
+ * Initializes the PIT. Programs the first interrupt and
+ * registers the IRQ handler.
  */
 void
 pit_init(void)
 {
-    pit_set_divisor(PIT_DIVISOR);
+    pit_program(PIT_MAX_MS);
     irq_register_handler(IRQ_PIT, pit_handle_irq);
 }
@@ -8,6 +8,12 @@
 /* Returns the current monotonic clock time in milliseconds */
 __cdecl int pit_monotime(void);
 
+/* Ensures that a timer interrupt occurs by the specified time */
+void pit_set_deadline(int when);
+
+/* Ensures that a scheduler tick occurs within one timeslice */
+void pit_request_tick(void);
+
 /* Initializes the PIT */
 void pit_init(void);
 
@@ -13,12 +13,13 @@
 #include "wait.h"
 #include "terminal.h"
 #include "vbe.h"
+#include "shm.h"
 
 /* Maximum length of string passed to execute()/exec() */
 #define MAX_EXEC_LEN 128
 
 /* Maximum number of processes, including idle process */
-#define MAX_PROCESSES 16
+#define MAX_PROCESSES 32
 
 /* Process data block size, MUST BE A POWER OF 2! */
 #define PROCESS_DATA_SIZE 8192
@@ -29,6 +30,11 @@
 /* Period of the alarm signal in milliseconds */
 #define SIGALRM_PERIOD_MS 10000
 
+/* How process_clone_impl() sets up the child's memory and files */
+#define CLONE_EMPTY  0 /* No address space (exec() follows), copied files */
+#define CLONE_COPY   1 /* Copy-on-write address space, copied files */
+#define CLONE_SHARE  2 /* Same address space and file table (threads) */
+
 /* Kernel stack struct */
 typedef union {
     pcb_t *pcb;
@@ -155,6 +161,8 @@ process_alloc_pcb(void)
 static void
 process_free_pcb(pcb_t *pcb)
 {
+    assert(list_empty(&pcb->children));
+    list_del(&pcb->sibling);
     pcb->pid = -1;
 }
 
@@ -242,25 +250,18 @@ get_kernel_base_esp(pcb_t *pcb)
     return stack_start + stack_size;
 }
 
-/*
- * Unsets the global execution context for the specified process.
- */
-static void
-process_unset_context(pcb_t *pcb)
-{
-    heap_unmap(&pcb->heap);
-}
-
 /*
  * Sets the global execution context for the specified process.
  */
 static void
 process_set_context(pcb_t *pcb)
 {
-    paging_map_user_page(pcb->user_paddr);
-    heap_map(&pcb->heap);
+    /* Swap all user mappings with a single TLB flush */
+    paging_begin_batch();
+    vm_install(pcb->vm);
     terminal_update_vidmap_page(pcb->terminal, pcb->vidmap);
     vbe_update_fbmap_page(pcb->fbmap);
+    paging_end_batch();
 
     /* Restore TSS entry */
     tss.esp0 = get_kernel_base_esp(pcb);
@@ -337,10 +338,6 @@ process_switch(pcb_t *curr, pcb_t *next)
     assert(next != NULL);
     assert(next->pid >= 0);
 
-    if (curr != NULL) {
-        process_unset_context(curr);
-    }
-
     if (next->state == PROCESS_STATE_NEW) {
         process_run(next);
     } else if (next->state == PROCESS_STATE_RUNNING) {
@@ -352,8 +349,11 @@ process_switch(pcb_t *curr, pcb_t *next)
 
 /*
  * Idle loop "process". Basically just handles interrupts
- * endlessly. This is the only place in the kernel where
- * interrupts are enabled.
+ * endlessly. Background work such as zeroing free frames is
+ * done by kernel threads, which are scheduled like normal
+ * processes. Apart from the framebuffer clear in fbmap() and
+ * the gaps between kernel thread work items, this is the
+ * only place in the kernel where interrupts are enabled.
  */
 static void
 process_idle(void)
@@ -408,10 +408,11 @@ process_fill_user_regs(int_regs_t *regs, uintptr_t entry_point)
 }
 
 /*
- * Initializes the registers used to schedule the idle task.
+ * Initializes the registers used to schedule a kernel-mode
+ * process (the idle task or a kernel thread) starting at entry.
  */
 static void
-process_fill_idle_regs(int_regs_t *regs)
+process_fill_kernel_regs(int_regs_t *regs, void (*entry)(void))
 {
     uint32_t eflags;
     asm volatile("pushfl; popl %0" : "=r"(eflags));
@@ -427,9 +428,9 @@ process_fill_idle_regs(int_regs_t *regs)
     regs->esi = 0;
     regs->edi = 0;
     regs->ebp = 0;
-    regs->eip = (uint32_t)process_idle;
+    regs->eip = (uint32_t)entry;
     regs->cs = KERNEL_CS;
-    regs->eflags = eflags & ~EFLAGS_USER;
+    regs->eflags = eflags & ~(EFLAGS_USER | EFLAGS_IF);
 }
 
 /*
@@ -441,40 +442,56 @@ process_close(pcb_t *pcb)
 {
     vbe_release(pcb->fbmap);
     pcb->fbmap = false;
-    if (pcb->user_paddr != 0) {
-        paging_page_free(pcb->user_paddr);
-        pcb->user_paddr = 0;
+    if (pcb->vm != NULL) {
+        vm_release(pcb->vm);
+        pcb->vm = NULL;
+    }
+    if (pcb->files != NULL) {
+        file_table_release(pcb->files);
+        pcb->files = NULL;
     }
-    file_deinit(pcb->files);
-    heap_clear(&pcb->heap);
     timer_cancel(&pcb->alarm_timer);
     scheduler_remove(pcb);
 }
 
 /*
- * Creates the idle process state. This must be called
- * before creating any other processes.
+ * Creates a process that runs entirely in kernel mode,
+ * starting at the specified function. It has no address
+ * space or open files, and does not keep its terminal
+ * alive. This is used for the idle process and for kernel
+ * threads; the caller is responsible for scheduling it.
+ * Returns NULL if the maximum number of processes are
+ * already running.
  */
-static pcb_t *
-process_create_idle(void)
+pcb_t *
+process_create_kernel(void (*entry)(void))
 {
     pcb_t *pcb = process_alloc_pcb();
-    assert(pcb != NULL && pcb->pid == 0);
+    if (pcb == NULL) {
+        debugf("Reached max number of processes\n");
+        return NULL;
+    }
 
     pcb->state = PROCESS_STATE_NEW;
     pcb->parent_pid = -1;
+    list_init(&pcb->children);
+    list_init(&pcb->sibling);
+    list_init(&pcb->exit_queue);
     pcb->terminal = 0;
     pcb->group = pcb->pid;
     pcb->vidmap = false;
     pcb->fbmap = false;
     pcb->compat = false;
-    pcb->user_paddr = 0;
-    file_init(pcb->files);
+    pcb->vm = NULL;
+    pcb->files = NULL;
     signal_init(pcb->signals);
-    heap_init_kernel(&pcb->heap, 0, 0, NULL);
     timer_init(&pcb->alarm_timer);
     list_init(&pcb->scheduler_list);
-    process_fill_idle_regs(&pcb->regs);
+    pcb->nice = 0;
+    pcb->rtprio = 0;
+    pcb->kthread = NULL;
+    pcb->args[0] = '\0';
+    process_fill_kernel_regs(&pcb->regs, entry);
 
     return pcb;
 }
@@ -500,18 +517,23 @@ process_create_user(char *command, int terminal)
 
     pcb->state = PROCESS_STATE_NEW;
     pcb->parent_pid = -1;
+    list_init(&pcb->children);
+    list_init(&pcb->sibling);
+    list_init(&pcb->exit_queue);
     pcb->terminal = terminal;
     pcb->group = pcb->pid;
     pcb->vidmap = false;
     pcb->fbmap = false;
     pcb->compat = false;
-    pcb->user_paddr = 0;
-    file_init(pcb->files);
+    pcb->vm = NULL;
+    pcb->files = NULL;
     signal_init(pcb->signals);
-    heap_init_user(&pcb->heap, USER_HEAP_START, USER_HEAP_END);
     timer_init(&pcb->alarm_timer);
     timer_setup(&pcb->alarm_timer, SIGALRM_PERIOD_MS, process_alarm_callback);
     list_init(&pcb->scheduler_list);
+    pcb->nice = 0;
+    pcb->rtprio = 0;
+    pcb->kthread = NULL;
 
     /* Parse command and find the executable inode */
     int inode_idx;
@@ -523,16 +545,16 @@ process_create_user(char *command, int terminal)
     }
     pcb->compat = compat;
 
-    /* Allocate physical memory to hold process */
-    pcb->user_paddr = paging_page_alloc();
-    if (pcb->user_paddr == 0) {
-        debugf("Cannot allocate user page for process\n");
+    /* Create address space for the process */
+    pcb->vm = vm_create();
+    if (pcb->vm == NULL) {
+        debugf("Cannot allocate address space for process\n");
         ret = NULL;
         goto error;
     }
 
-    /* Copy program into physical memory */
-    uintptr_t entry_point = elf_load(inode_idx, pcb->user_paddr, pcb->compat);
+    /* Copy program into memory */
+    uintptr_t entry_point = elf_load(inode_idx, pcb->vm, pcb->compat);
     if (entry_point == 0) {
         debugf("Could not load user program\n");
         ret = NULL;
@@ -540,7 +562,12 @@ process_create_user(char *command, int terminal)
     }
 
     /* Open stdin/stdout/stderr files */
-    if (terminal_open_streams(pcb->files) < 0) {
+    pcb->files = file_table_alloc();
+    if (pcb->files == NULL) {
+        ret = NULL;
+        goto error;
+    }
+    if (terminal_open_streams(pcb->files->files) < 0) {
         debugf("Could not open tty streams\n");
         ret = NULL;
         goto error;
@@ -572,12 +599,15 @@ error:
 
 /*
  * Clones the specified process. regs points to the original
- * process's interrupt context on the stack. If clone_pages is
- * false, the user and heap pages will NOT be cloned, which is
- * useful if this is immediately followed by exec().
+ * process's interrupt context on the stack. mode is one of
+ * the CLONE_* constants: with CLONE_EMPTY, the address space
+ * will NOT be cloned, which is useful if this is immediately
+ * followed by exec(). With CLONE_SHARE, the child is a thread
+ * that uses the same address space and file table as the
+ * parent.
  */
 static pcb_t *
-process_clone(pcb_t *parent_pcb, int_regs_t *regs, bool clone_pages)
+process_clone_impl(pcb_t *parent_pcb, int_regs_t *regs, int mode)
 {
     pcb_t *ret;
     pcb_t *child_pcb = NULL;
@@ -592,38 +622,49 @@ process_clone(pcb_t *parent_pcb, int_regs_t *regs, bool clone_pages)
 
     child_pcb->state = PROCESS_STATE_NEW;
     child_pcb->parent_pid = parent_pcb->pid;
+    list_init(&child_pcb->children);
+    list_add_tail(&child_pcb->sibling, &parent_pcb->children);
+    list_init(&child_pcb->exit_queue);
     child_pcb->terminal = parent_pcb->terminal;
     child_pcb->group = parent_pcb->group;
     child_pcb->vidmap = parent_pcb->vidmap;
     child_pcb->fbmap = vbe_retain(parent_pcb->fbmap);
     child_pcb->compat = parent_pcb->compat;
-    child_pcb->user_paddr = 0;
-    file_clone(child_pcb->files, parent_pcb->files);
+    child_pcb->vm = NULL;
+    child_pcb->files = NULL;
     signal_clone(child_pcb->signals, parent_pcb->signals);
-    heap_init_user(&child_pcb->heap, USER_HEAP_START, USER_HEAP_END);
     timer_clone(&child_pcb->alarm_timer, &parent_pcb->alarm_timer);
     list_init(&child_pcb->scheduler_list);
+    child_pcb->nice = parent_pcb->nice;
+    child_pcb->rtprio = 0;
+    child_pcb->kthread = NULL;
     strcpy(child_pcb->args, parent_pcb->args);
     child_pcb->regs = *regs;
     child_pcb->regs.eax = 0;
 
-    /* Allocate physical memory to hold process */
-    child_pcb->user_paddr = paging_page_alloc();
-    if (child_pcb->user_paddr == 0) {
-        debugf("Cannot allocate user page for child process\n");
-        ret = NULL;
-        goto error;
+    if (mode == CLONE_SHARE) {
+        /* Threads see each other's memory and descriptors */
+        child_pcb->vm = vm_retain(parent_pcb->vm);
+        child_pcb->files = file_table_retain(parent_pcb->files);
+    } else {
+        child_pcb->files = file_table_clone(parent_pcb->files);
+        if (child_pcb->files == NULL) {
+            ret = NULL;
+            goto error;
+        }
     }
 
-    /* Copy page contents from parent process */
-    if (clone_pages) {
-        if (heap_clone(&child_pcb->heap, &parent_pcb->heap) < 0) {
-            debugf("Cannot allocate heap for child process\n");
+    /*
+     * Share page contents with parent process. The pages are
+     * copied lazily when either process writes to them.
+     */
+    if (mode == CLONE_COPY) {
+        child_pcb->vm = vm_clone(parent_pcb->vm);
+        if (child_pcb->vm == NULL) {
+            debugf("Cannot clone address space for child process\n");
             ret = NULL;
             goto error;
         }
-
-        paging_clone_user_page(child_pcb->user_paddr);
     }
 
     /* Schedule child for execution */
@@ -645,7 +686,9 @@ error:
  * Performs an exec() on behalf of the specified process.
  * regs must point to the saved interrupt context on the
  * stack if the process has already been into userspace
- * (i.e. is calling exec()), or pcb->regs otherwise.
+ * (i.e. is calling exec()), or pcb->regs otherwise. Returns
+ * 0 on success, -ENOENT if the command does not name a valid
+ * executable, or -1 on any other error.
  */
 static int
 process_exec_impl(pcb_t *pcb, int_regs_t *regs, const char *command)
@@ -662,20 +705,56 @@ process_exec_impl(pcb_t *pcb, int_regs_t *regs, const char *command)
     bool compat;
     if (process_parse_cmd(cmd, &inode_idx, pcb->args, &compat) < 0) {
         debugf("Invalid command/executable file\n");
+        return -ENOENT;
+    }
+
+    /*
+     * Load the program into a new address space, so that
+     * the old one is left intact if loading fails.
+     */
+    vm_t *vm = vm_create();
+    if (vm == NULL) {
+        debugf("Cannot allocate address space for process\n");
         return -1;
     }
 
-    /* Copy program into physical memory */
-    uintptr_t entry_point = elf_load(inode_idx, pcb->user_paddr, compat);
+    /* Copy program into memory */
+    uintptr_t entry_point = elf_load(inode_idx, vm, compat);
     if (entry_point == 0) {
         debugf("Could not load user program\n");
+        vm_destroy(vm);
         return -1;
     }
 
+    /*
+     * A thread that calls exec() stops sharing its open files
+     * with the other threads, since it is now running a new
+     * program. The new table keeps the same open files.
+     */
+    if (pcb->files != NULL && pcb->files->refcnt > 1) {
+        file_table_t *files = file_table_clone(pcb->files);
+        if (files == NULL) {
+            debugf("Cannot allocate file table for process\n");
+            vm_destroy(vm);
+            return -1;
+        }
+        file_table_release(pcb->files);
+        pcb->files = files;
+    }
+
+    /* Replace the old address space */
+    vm_t *old_vm = pcb->vm;
+    pcb->vm = vm;
+    if (pcb == get_executing_pcb()) {
+        vm_install(pcb->vm);
+    }
+    if (old_vm != NULL) {
+        vm_release(old_vm);
+    }
+
     /* Reset process state that should not be persisted across exec() */
     pcb->compat = compat;
     signal_init(pcb->signals);
-    heap_clear(&pcb->heap);
     timer_setup(&pcb->alarm_timer, SIGALRM_PERIOD_MS, process_alarm_callback);
 
     /* Reinitialize user register values with new entry point */
@@ -686,21 +765,19 @@ process_exec_impl(pcb_t *pcb, int_regs_t *regs, const char *command)
 /*
  * wait() implementation. Note that this is non-blocking,
  * and will return -EAGAIN if no processes are ready to be
- * reaped. To implement a blocking wait(), simply call this
- * in a loop.
+ * reaped. To implement a blocking wait(), call this in a
+ * loop while waiting on the parent's exit_queue. Only the
+ * parent's own children are examined.
  */
 static int
-process_wait_impl(int parent_pid, int *pid)
+process_wait_impl(pcb_t *parent_pcb, int *pid)
 {
     int kpid = *pid;
     bool exists = false;
 
-    pcb_t *pcb;
-    process_for_each(pcb) {
-        /* Can't reap other people's children */
-        if (pcb->parent_pid != parent_pid) {
-            continue;
-        }
+    list_t *pos;
+    list_for_each(pos, &parent_pcb->children) {
+        pcb_t *pcb = list_entry(pos, pcb_t, sibling);
 
         /* Check if PID matches our query */
         if (pcb->pid != kpid && pcb->group != -kpid) {
@@ -732,9 +809,9 @@ process_wait_impl(int parent_pid, int *pid)
  * PID to upid (userspace pointer).
  */
 static int
-process_wait_impl_user(int parent_pid, int *kpid, int *upid)
+process_wait_impl_user(pcb_t *parent_pcb, int *kpid, int *upid)
 {
-    int ret = process_wait_impl(parent_pid, kpid);
+    int ret = process_wait_impl(parent_pcb, kpid);
     if (ret < 0) {
         return ret;
     }
@@ -788,13 +865,13 @@ process_sbrk(int delta, void **orig_brk)
     pcb_t *pcb = get_executing_pcb();
 
     /* Try to copy the address first to avoid having to revert the change */
-    void *brk = heap_sbrk(&pcb->heap, 0);
+    void *brk = vm_sbrk(pcb->vm, 0);
     if (orig_brk != NULL && !copy_to_user(orig_brk, &brk, sizeof(void *))) {
         return -1;
     }
 
     /* Resize the heap */
-    void *ret = heap_sbrk(&pcb->heap, delta);
+    void *ret = vm_sbrk(pcb->vm, delta);
     if (ret == NULL) {
         return -1;
     }
@@ -802,6 +879,87 @@ process_sbrk(int delta, void **orig_brk)
     return 0;
 }
 
+/*
+ * mmap() syscall handler. Maps length bytes of the specified
+ * file starting at offset (which must be 4KB-aligned) into the
+ * caller's address space, and writes the address of the mapping
+ * to ptr. The file's data is mapped directly rather than copied.
+ * By default the mapping is read-only; if MMAP_PRIVATE is set,
+ * it is writable, but changes are private to the process and
+ * are not written back to the file. The file cannot be
+ * modified while it is mapped.
+ *
+ * If fd refers to a shared memory segment, the mapping is
+ * always writable and changes are seen by all processes that
+ * map the segment. The range must lie within the segment,
+ * which cannot be resized while it is mapped. Returns 0 on
+ * success, or -1 on failure.
+ */
+__cdecl int
+process_mmap(void **ptr, int fd, int offset, int length, int flags)
+{
+    pcb_t *pcb = get_executing_pcb();
+
+    file_obj_t *file = get_executing_file(fd);
+    if (file == NULL) {
+        debugf("Cannot mmap fd %d\n", fd);
+        return -1;
+    }
+
+    uintptr_t addr;
+    shm_t *shm = shm_from_file(file);
+    if (shm != NULL) {
+        if (length <= 0 || offset < 0 || offset % FRAME_SIZE != 0 ||
+            length > shm->size - offset || (flags & MMAP_PRIVATE)) {
+            debugf("Invalid shared memory mmap range\n");
+            return -1;
+        }
+
+        addr = vm_mmap_shm(pcb->vm, length, shm, offset);
+    } else {
+        if (file->inode_idx < 0 || !(file->mode & OPEN_READ)) {
+            debugf("Cannot mmap fd %d\n", fd);
+            return -1;
+        }
+
+        int size = fs_inode_size(file->inode_idx);
+        if (length <= 0 || offset < 0 || offset % FRAME_SIZE != 0 || offset >= size) {
+            debugf("Invalid mmap range\n");
+            return -1;
+        }
+
+        addr = vm_mmap(
+            pcb->vm,
+            length,
+            file->inode_idx,
+            offset,
+            min(length, size - offset),
+            (flags & MMAP_PRIVATE) != 0);
+    }
+
+    if (addr == 0) {
+        return -1;
+    }
+
+    if (!copy_to_user(ptr, &addr, sizeof(void *))) {
+        vm_munmap(pcb->vm, addr);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * munmap() syscall handler. Removes a mapping created by
+ * mmap(). ptr must be the address returned by mmap().
+ */
+__cdecl int
+process_munmap(void *ptr)
+{
+    pcb_t *pcb = get_executing_pcb();
+    return vm_munmap(pcb->vm, (uintptr_t)ptr);
+}
+
 /*
  * fork() syscall handler. Creates a clone of the current
  * process. All state is preserved except for pending signals.
@@ -820,10 +978,46 @@ process_fork(
      * begins execution in idt_unwind_stack (i.e. skips
      * all normal C stack unwinding).
      */
-    pcb_t *child_pcb = process_clone(get_executing_pcb(), regs, true);
+    pcb_t *child_pcb = process_clone_impl(get_executing_pcb(), regs, CLONE_COPY);
+    if (child_pcb == NULL) {
+        return -1;
+    }
+    return child_pcb->pid;
+}
+
+/*
+ * clone() syscall handler. Creates a thread that shares the
+ * address space (including the heap) and file table of the
+ * calling process. The thread gets its own PID, registers
+ * and signal state, and starts by returning 0 from clone()
+ * with its stack pointer set to stack. Like a forked child,
+ * it must be reaped with wait() once it exits. Returns the
+ * PID of the thread, or -1 on error.
+ */
+__cdecl int
+process_clone(
+    void *stack,
+    intptr_t unused1,
+    intptr_t unused2,
+    intptr_t unused3,
+    intptr_t unused4,
+    int_regs_t *regs)
+{
+    /*
+     * The stack is not validated beyond this; if it is bad,
+     * the thread takes a page fault on its first push.
+     */
+    if (stack == NULL) {
+        debugf("Invalid thread stack\n");
+        return -1;
+    }
+
+    /* Like fork(), all code below executes in the parent */
+    pcb_t *child_pcb = process_clone_impl(get_executing_pcb(), regs, CLONE_SHARE);
     if (child_pcb == NULL) {
         return -1;
     }
+    child_pcb->regs.esp = (uintptr_t)stack;
     return child_pcb->pid;
 }
 
@@ -874,8 +1068,8 @@ process_wait(int *pid)
 
     /* Wait for a process to die and copy its PID */
     return WAIT_INTERRUPTIBLE(
-        process_wait_impl_user(pcb->pid, &kpid, pid),
-        NULL,
+        process_wait_impl_user(pcb, &kpid, pid),
+        &pcb->exit_queue,
         false);
 }
 
@@ -937,6 +1131,129 @@ process_setpgrp(int pid, int pgrp)
     return 0;
 }
 
+/*
+ * Performs the file actions passed to spawn() on the
+ * file descriptor table of the child process. Returns
+ * -1 if any of the actions are invalid.
+ */
+static int
+process_spawn_files(file_obj_t **files, const spawn_action_t *actions, int nactions)
+{
+    int i;
+    for (i = 0; i < nactions; ++i) {
+        const spawn_action_t *action = &actions[i];
+        int srcfd = action->srcfd;
+
+        if (action->type == SPAWN_DUP) {
+            if (srcfd < 0 || srcfd >= MAX_FILES || files[srcfd] == NULL) {
+                debugf("Invalid spawn dup source fd: %d\n", srcfd);
+                return -1;
+            }
+            if (file_desc_rebind(files, action->destfd, files[srcfd]) < 0) {
+                debugf("Invalid spawn dup dest fd: %d\n", action->destfd);
+                return -1;
+            }
+        } else if (action->type == SPAWN_CLOSE) {
+            if (file_desc_unbind(files, srcfd) < 0) {
+                debugf("Invalid spawn close fd: %d\n", srcfd);
+                return -1;
+            }
+        } else if (action->type == SPAWN_TCSETPGRP) {
+            /* Applied by process_spawn() once the group is known */
+        } else {
+            debugf("Invalid spawn action type: %d\n", action->type);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * spawn() syscall handler. Creates a child process running
+ * the specified command, equivalent to fork() + exec() but
+ * without cloning the address space of the caller. Before
+ * the child starts executing, the file actions are applied
+ * to its file descriptors in order, and its process group
+ * is set to pgrp (if pgrp == 0, the child's PID is used; if
+ * pgrp < 0, the group is inherited from the caller). If a
+ * SPAWN_TCSETPGRP action is given, that group also becomes
+ * the terminal's foreground group, so the child can never
+ * run in the background by mistake. Returns the PID of the
+ * child process; -EAGAIN if the child could not be created
+ * (usually because the maximum number of processes are
+ * already running), -ENOENT if the command is not a valid
+ * executable, or -1 on any other error.
+ */
+__cdecl int
+process_spawn(
+    const char *command,
+    const spawn_action_t *actions,
+    int nactions,
+    int pgrp,
+    intptr_t unused1,
+    int_regs_t *regs)
+{
+    int ret;
+    pcb_t *child_pcb = NULL;
+
+    /* Copy file actions into kernel memory */
+    spawn_action_t kactions[MAX_SPAWN_ACTIONS];
+    if (nactions < 0 || nactions > MAX_SPAWN_ACTIONS) {
+        debugf("Invalid number of spawn actions: %d\n", nactions);
+        ret = -1;
+        goto error;
+    }
+    if (!copy_from_user(kactions, actions, nactions * sizeof(spawn_action_t))) {
+        debugf("Invalid spawn actions buffer\n");
+        ret = -1;
+        goto error;
+    }
+
+    /* Create the child without copying our address space */
+    child_pcb = process_clone_impl(get_executing_pcb(), regs, CLONE_EMPTY);
+    if (child_pcb == NULL) {
+        ret = -EAGAIN;
+        goto error;
+    }
+
+    if (process_spawn_files(child_pcb->files->files, kactions, nactions) < 0) {
+        ret = -1;
+        goto error;
+    }
+
+    ret = process_exec_impl(child_pcb, &child_pcb->regs, command);
+    if (ret < 0) {
+        goto error;
+    }
+
+    /* Set the group before the child gets a chance to run */
+    if (pgrp == 0) {
+        child_pcb->group = child_pcb->pid;
+    } else if (pgrp > 0) {
+        child_pcb->group = pgrp;
+    }
+
+    /* Likewise for the terminal foreground, if requested */
+    int i;
+    for (i = 0; i < nactions; ++i) {
+        if (kactions[i].type == SPAWN_TCSETPGRP) {
+            terminal_tcsetpgrp_impl(child_pcb->terminal, child_pcb->group);
+        }
+    }
+
+    ret = child_pcb->pid;
+
+exit:
+    return ret;
+
+error:
+    if (child_pcb != NULL) {
+        process_close(child_pcb);
+        process_free_pcb(child_pcb);
+    }
+    goto exit;
+}
+
 /*
  * execute() syscall handler. This is provided for ABI
  * compatibility with the original fs programs. It is identical
@@ -959,7 +1276,7 @@ process_execute(
 
     /* Start by cloning ourselves */
     pcb_t *parent_pcb = get_executing_pcb();
-    child_pcb = process_clone(parent_pcb, regs, false);
+    child_pcb = process_clone_impl(parent_pcb, regs, CLONE_EMPTY);
     if (child_pcb == NULL) {
         ret = -1;
         goto error;
@@ -975,7 +1292,7 @@ process_execute(
     if (child_pcb->compat) {
         int fd;
         for (fd = 2; fd < MAX_FILES; ++fd) {
-            file_desc_unbind(child_pcb->files, fd);
+            file_desc_unbind(child_pcb->files->files, fd);
         }
     }
 
@@ -986,8 +1303,8 @@ process_execute(
 
     /* Wait for the child process to exit, ignoring signals */
     int exit_code = WAIT_UNINTERRUPTIBLE(
-        process_wait_impl(parent_pcb->pid, &child_pcb->pid),
-        NULL,
+        process_wait_impl(parent_pcb, &child_pcb->pid),
+        &parent_pcb->exit_queue,
         false);
 
     /* Restore the original foreground group */
@@ -1023,13 +1340,13 @@ process_halt_impl(int status)
      * Orphan any processes created by this process,
      * and reap the ones that have already exited.
      */
-    pcb_t *other_pcb, *next_pcb;
-    process_for_each_safe(other_pcb, next_pcb) {
-        if (other_pcb->parent_pid == child_pcb->pid) {
-            other_pcb->parent_pid = -1;
-            if (other_pcb->state == PROCESS_STATE_ZOMBIE) {
-                process_free_pcb(other_pcb);
-            }
+    list_t *pos, *next;
+    list_for_each_safe(pos, next, &child_pcb->children) {
+        pcb_t *other_pcb = list_entry(pos, pcb_t, sibling);
+        other_pcb->parent_pid = -1;
+        list_del(&other_pcb->sibling);
+        if (other_pcb->state == PROCESS_STATE_ZOMBIE) {
+            process_free_pcb(other_pcb);
         }
     }
 
@@ -1050,8 +1367,9 @@ process_halt_impl(int status)
          * the fact that we do not have an init process.
          */
         bool restart = true;
+        pcb_t *other_pcb;
         process_for_each(other_pcb) {
-            if (other_pcb->terminal == terminal) {
+            if (other_pcb->terminal == terminal && other_pcb->kthread == NULL) {
                 restart = false;
                 break;
             }
@@ -1073,7 +1391,7 @@ process_halt_impl(int status)
 
         /* Wake parent to notify them that child is dead */
         pcb_t *parent_pcb = get_pcb(child_pcb->parent_pid);
-        scheduler_wake(parent_pcb);
+        wait_queue_wake(&parent_pcb->exit_queue);
     }
 
     /* Switch away from this process for the last time */
@@ -1136,18 +1454,21 @@ process_init(void)
     for (i = 0; i < MAX_PROCESSES; ++i) {
         process_info[i].pid = -1;
     }
+
+    /* The idle process must be created first, so that it gets PID 0 */
+    pcb_t *idle = process_create_kernel(process_idle);
+    assert(idle != NULL && idle->pid == 0);
 }
 
 /* She spawns C shells by the seashore */
 __noreturn void
 process_start_shell(void)
 {
-    pcb_t *idle = process_create_idle();
     int i;
     for (i = 0; i < NUM_TERMINALS; ++i) {
         char cmd[] = INIT_PROCESS;
         pcb_t *pcb = process_create_user(cmd, i);
         assert(pcb != NULL);
     }
-    process_run(idle);
+    process_run(get_idle_pcb());
 }
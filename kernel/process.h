@@ -7,7 +7,7 @@
 #include "idt.h"
 #include "signal.h"
 #include "timer.h"
-#include "heap.h"
+#include "vm.h"
 
 /* Maximum argument length, including the NUL terminator */
 #define MAX_ARGS_LEN 128
@@ -21,8 +21,30 @@
 /* Direction flag */
 #define EFLAGS_DF (1 << 10)
 
+/* Maximum number of file actions that can be passed to spawn() */
+#define MAX_SPAWN_ACTIONS 16
+
+/* spawn() action types */
+#define SPAWN_DUP 0
+#define SPAWN_CLOSE 1
+#define SPAWN_TCSETPGRP 2
+
 #ifndef ASM
 
+/*
+ * Action performed on the child process by spawn().
+ * SPAWN_DUP makes destfd refer to the same file as srcfd
+ * (like dup(srcfd, destfd)); SPAWN_CLOSE closes srcfd
+ * (destfd is ignored). SPAWN_TCSETPGRP makes the child's
+ * process group the foreground group of its terminal before
+ * the child runs (srcfd and destfd are ignored).
+ */
+typedef struct {
+    int type;
+    int srcfd;
+    int destfd;
+} spawn_action_t;
+
 /* Execution state of the process */
 typedef enum {
     /*
@@ -69,6 +91,19 @@ typedef struct {
      */
     int parent_pid;
 
+    /*
+     * Processes created by this process that have not been
+     * reaped yet, and this process's node in its parent's list.
+     */
+    list_t children;
+    list_t sibling;
+
+    /*
+     * Wait queue for wait(), notified when one of this
+     * process's children exits.
+     */
+    list_t exit_queue;
+
     /*
      * Which terminal the process is executing on. Inherited from
      * the parent.
@@ -108,26 +143,24 @@ typedef struct {
     bool compat : 1;
 
     /*
-     * Allocated physical address for this process's 128MB page.
+     * User address space of this process, shared with any
+     * threads created by clone(). NULL for kernel processes,
+     * and briefly for children created by execute() before
+     * their program has been loaded.
      */
-    uintptr_t user_paddr;
+    vm_t *vm;
 
     /*
-     * Array containing open file object pointers. The index in the
-     * array corresponds to the file descriptor.
+     * Table of open files, shared with any threads created by
+     * clone(). NULL for kernel processes.
      */
-    file_obj_t *files[MAX_FILES];
+    file_table_t *files;
 
     /*
      * Signal handler and status array.
      */
     signal_info_t signals[NUM_SIGNALS];
 
-    /*
-     * Heap metadata for this process.
-     */
-    heap_t heap;
-
     /*
      * Timer for the SIGALRM signal.
      */
@@ -138,6 +171,25 @@ typedef struct {
      */
     list_t scheduler_list;
 
+    /*
+     * Nice value of the process, which determines its base
+     * priority level. Inherited from the parent.
+     */
+    int nice;
+
+    /*
+     * Real-time priority of the process, or 0 if this is a
+     * normal process. Not inherited by children.
+     */
+    int rtprio;
+
+    /*
+     * Current priority level of the process, and the number of
+     * ticks it has run for in its current timeslice.
+     */
+    int sched_level;
+    int sched_ticks;
+
     /*
      * Kernel ESP/EBP of the process inside the scheduler. Used to
      * context switch between processes. Only valid if state == RUNNING.
@@ -145,6 +197,12 @@ typedef struct {
     uint32_t scheduler_esp;
     uint32_t scheduler_ebp;
 
+    /*
+     * Kernel thread that this process executes, or NULL if
+     * this is a user process (or the idle process).
+     */
+    struct kthread *kthread;
+
     /*
      * Arguments passed when creating this process. Will always be
      * NUL-terminated (holds up to MAX_ARGS_LEN - 1 characters).
@@ -189,10 +247,15 @@ pcb_t *get_next_pcb(pcb_t *pcb);
 /* Gets the PCB of the currently executing process */
 pcb_t *get_executing_pcb(void);
 
+/* Creates a process that runs in kernel mode */
+pcb_t *process_create_kernel(void (*entry)(void));
+
 /* Process syscall handlers */
 __cdecl int process_getargs(char *buf, int nbytes);
 __cdecl int process_vidmap(uint8_t **screen_start);
 __cdecl int process_sbrk(int delta, void **orig_brk);
+__cdecl int process_mmap(void **ptr, int fd, int offset, int length, int flags);
+__cdecl int process_munmap(void *ptr);
 __cdecl int process_fork(
     intptr_t unused1,
     intptr_t unused2,
@@ -200,6 +263,13 @@ __cdecl int process_fork(
     intptr_t unused4,
     intptr_t unused5,
     int_regs_t *regs);
+__cdecl int process_clone(
+    void *stack,
+    intptr_t unused1,
+    intptr_t unused2,
+    intptr_t unused3,
+    intptr_t unused4,
+    int_regs_t *regs);
 __cdecl int process_exec(
     const char *command,
     intptr_t unused1,
@@ -218,6 +288,13 @@ __cdecl int process_execute(
     intptr_t unused3,
     intptr_t unused4,
     int_regs_t *regs);
+__cdecl int process_spawn(
+    const char *command,
+    const spawn_action_t *actions,
+    int nactions,
+    int pgrp,
+    intptr_t unused1,
+    int_regs_t *regs);
 __cdecl __noreturn void process_halt(int status);
 __cdecl int process_sleep(int target);
 
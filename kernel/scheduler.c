@@ -2,33 +2,200 @@
 #include "types.h"
 #include "debug.h"
 #include "list.h"
+#include "math.h"
+#include "bitmap.h"
+#include "printf.h"
 #include "process.h"
 #include "timer.h"
+#include "pit.h"
 
 /*
- * Queue of processes waiting to be scheduled.
- * Note that the idle task is not in these queues, and is
- * only scheduled when there are no other processes to run.
+ * Number of times a process can be demoted below its base
+ * level for using up its entire timeslice.
  */
-static list_define(scheduler_queue);
+#define SCHEDULER_MAX_DEMOTIONS 3
 
 /*
- * Returns the next process to be scheduled and moves it to the
- * back of the queue.
+ * Number of priority levels reserved for real-time processes.
+ * These come before all normal levels, one per real-time priority.
+ */
+#define SCHEDULER_RT_LEVELS RTPRIO_MAX
+
+/*
+ * Number of priority levels. Level 0 is the highest priority.
+ * Each nice value has its own base level, and processes can
+ * be demoted up to SCHEDULER_MAX_DEMOTIONS levels below that.
+ */
+#define SCHEDULER_NUM_LEVELS \
+    (SCHEDULER_RT_LEVELS + NICE_MAX - NICE_MIN + 1 + SCHEDULER_MAX_DEMOTIONS)
+
+/*
+ * Real-time processes may use at most SCHEDULER_RT_BUDGET_TICKS
+ * out of every SCHEDULER_RT_PERIOD_TICKS ticks while normal
+ * processes are runnable, so that a runaway real-time process
+ * cannot lock up the system.
+ */
+#define SCHEDULER_RT_PERIOD_TICKS 100
+#define SCHEDULER_RT_BUDGET_TICKS 80
+
+/* Whether the specified level belongs to the real-time class */
+#define scheduler_is_rt_level(level) ((level) < SCHEDULER_RT_LEVELS)
+
+/*
+ * Number of ticks between priority boosts, where every runnable
+ * process is moved back to its base level. Prevents CPU-bound
+ * processes from being starved forever.
+ */
+#define SCHEDULER_BOOST_TICKS 100
+
+/*
+ * Per-level statistics, to help tune the parameters above.
+ */
+typedef struct {
+    /* Current number of processes in the queue */
+    int len;
+
+    /* Largest value of len seen */
+    int max_len;
+
+    /* Sum of len sampled at every tick */
+    uint32_t len_sum;
+
+    /* Number of times a process was picked from this queue */
+    uint32_t picks;
+
+    /* Number of processes demoted from this level */
+    uint32_t demotions;
+} scheduler_stats_t;
+
+/*
+ * Queues of processes waiting to be scheduled, one for each
+ * priority level. Note that the idle task is not in these queues,
+ * and is only scheduled when there are no other processes to run.
+ */
+static list_t scheduler_queues[SCHEDULER_NUM_LEVELS];
+
+/* Bitmap of which queues are non-empty */
+static bitmap_define(scheduler_queue_map, SCHEDULER_NUM_LEVELS);
+
+/* Statistics for each queue */
+static scheduler_stats_t scheduler_stats[SCHEDULER_NUM_LEVELS];
+
+/* Number of runnable processes, excluding the idle task */
+static int scheduler_num_running = 0;
+
+/* Number of ticks elapsed, and since the last priority boost */
+static uint32_t scheduler_ticks = 0;
+static int scheduler_boost_ticks = 0;
+
+/*
+ * Number of ticks used by real-time processes in the current
+ * period, and whether they have exceeded their budget.
+ */
+static int scheduler_rt_period_ticks = 0;
+static int scheduler_rt_ticks = 0;
+static bool scheduler_rt_throttled = false;
+
+/* Number of times real-time processes were throttled */
+static uint32_t scheduler_rt_throttle_count = 0;
+
+/*
+ * Returns the base priority level of a process, as determined
+ * by its real-time priority, or its nice value for normal
+ * processes.
+ */
+static int
+scheduler_base_level(pcb_t *pcb)
+{
+    if (pcb->rtprio > 0) {
+        return RTPRIO_MAX - pcb->rtprio;
+    }
+    return SCHEDULER_RT_LEVELS + pcb->nice - NICE_MIN;
+}
+
+/*
+ * Returns the length of a process's timeslice in ticks.
+ * Processes get longer (but less frequent) timeslices
+ * the further they are demoted.
+ */
+static int
+scheduler_slice_ticks(pcb_t *pcb)
+{
+    return 1 << (pcb->sched_level - scheduler_base_level(pcb));
+}
+
+/*
+ * Returns the highest priority level with a runnable
+ * process, or SCHEDULER_NUM_LEVELS if there are none.
+ * If real-time processes have used up their budget, they
+ * only run if there are no normal processes to run.
+ */
+static int
+scheduler_top_level(void)
+{
+    if (scheduler_rt_throttled) {
+        int level = bitmap_find_next_one(
+            scheduler_queue_map, SCHEDULER_RT_LEVELS, SCHEDULER_NUM_LEVELS);
+        if (level < SCHEDULER_NUM_LEVELS) {
+            return level;
+        }
+    }
+    return bitmap_find_one(scheduler_queue_map, SCHEDULER_NUM_LEVELS);
+}
+
+/*
+ * Inserts a process at the back of the queue for the
+ * specified level.
+ */
+static void
+scheduler_enqueue(pcb_t *pcb, int level)
+{
+    scheduler_stats_t *stats = &scheduler_stats[level];
+    pcb->sched_level = level;
+    list_add_tail(&pcb->scheduler_list, &scheduler_queues[level]);
+    bitmap_set(scheduler_queue_map, level);
+    if (++stats->len > stats->max_len) {
+        stats->max_len = stats->len;
+    }
+}
+
+/*
+ * Removes a process from the queue it is currently in.
+ */
+static void
+scheduler_dequeue(pcb_t *pcb)
+{
+    int level = pcb->sched_level;
+    list_del(&pcb->scheduler_list);
+    if (list_empty(&scheduler_queues[level])) {
+        bitmap_clear(scheduler_queue_map, level);
+    }
+    scheduler_stats[level].len--;
+}
+
+/*
+ * Returns the next process to be scheduled. Normal processes
+ * are moved to the back of their queue; real-time processes
+ * stay at the front until they sleep (first in, first out).
  */
 static pcb_t *
 scheduler_next_pcb(void)
 {
     /* If no processes to run, schedule the idle task */
-    if (list_empty(&scheduler_queue)) {
+    int level = scheduler_top_level();
+    if (level >= SCHEDULER_NUM_LEVELS) {
         return get_idle_pcb();
     }
 
     /* Pop the first process from the queue and move it to the end */
-    pcb_t *pcb = list_first_entry(&scheduler_queue, pcb_t, scheduler_list);
-    list_del(&pcb->scheduler_list);
-    list_add_tail(&pcb->scheduler_list, &scheduler_queue);
+    pcb_t *pcb = list_first_entry(&scheduler_queues[level], pcb_t, scheduler_list);
+    if (!scheduler_is_rt_level(level)) {
+        list_del(&pcb->scheduler_list);
+        list_add_tail(&pcb->scheduler_list, &scheduler_queues[level]);
+    }
 
+    pcb->sched_ticks = 0;
+    scheduler_stats[level].picks++;
     return pcb;
 }
 
@@ -92,13 +259,21 @@ scheduler_exit(void)
 }
 
 /*
- * Adds a process to the scheduler queue.
+ * Adds a process to the scheduler queue. The process starts
+ * at its base priority level, so processes that wake up from
+ * sleep get priority over ones that have been hogging the CPU.
  */
 void
 scheduler_add(pcb_t *pcb)
 {
     assert(pcb->pid > 0);
-    list_add_tail(&pcb->scheduler_list, &scheduler_queue);
+    pcb->sched_ticks = 0;
+    scheduler_enqueue(pcb, scheduler_base_level(pcb));
+
+    /* We need timeslices now that there is competition */
+    if (++scheduler_num_running > 1) {
+        pit_request_tick();
+    }
 }
 
 /*
@@ -108,7 +283,192 @@ void
 scheduler_remove(pcb_t *pcb)
 {
     assert(pcb->pid > 0);
-    list_del(&pcb->scheduler_list);
+    scheduler_dequeue(pcb);
+    scheduler_num_running--;
+}
+
+/*
+ * Returns whether the scheduler needs periodic ticks to
+ * share the CPU, i.e. if more than one process is runnable.
+ */
+bool
+scheduler_needs_tick(void)
+{
+    return scheduler_num_running > 1;
+}
+
+/*
+ * Moves every runnable process back to its base level.
+ */
+static void
+scheduler_boost(void)
+{
+    int level;
+    for (level = SCHEDULER_RT_LEVELS; level < SCHEDULER_NUM_LEVELS; ++level) {
+        list_t *pos, *next;
+        list_for_each_safe(pos, next, &scheduler_queues[level]) {
+            pcb_t *pcb = list_entry(pos, pcb_t, scheduler_list);
+            int base = scheduler_base_level(pcb);
+            if (level > base) {
+                scheduler_dequeue(pcb);
+                scheduler_enqueue(pcb, base);
+            }
+        }
+    }
+}
+
+/*
+ * Called on every timer interrupt. Charges the tick to the
+ * executing process, demoting it if it has used up its entire
+ * timeslice, and yields if it should be preempted.
+ */
+void
+scheduler_tick(void)
+{
+    int level;
+    scheduler_ticks++;
+    for (level = 0; level < SCHEDULER_NUM_LEVELS; ++level) {
+        scheduler_stats[level].len_sum += scheduler_stats[level].len;
+    }
+
+    if (++scheduler_boost_ticks >= SCHEDULER_BOOST_TICKS) {
+        scheduler_boost_ticks = 0;
+        scheduler_boost();
+    }
+
+    if (++scheduler_rt_period_ticks >= SCHEDULER_RT_PERIOD_TICKS) {
+        scheduler_rt_period_ticks = 0;
+        scheduler_rt_ticks = 0;
+        scheduler_rt_throttled = false;
+    }
+
+    pcb_t *curr = get_executing_pcb();
+    if (curr->pid > 0 && scheduler_is_rt_level(curr->sched_level)) {
+        /* Watchdog: stop real-time processes that exceed their budget */
+        if (++scheduler_rt_ticks >= SCHEDULER_RT_BUDGET_TICKS && !scheduler_rt_throttled) {
+            debugf("Throttling real-time processes\n");
+            scheduler_rt_throttled = true;
+            scheduler_rt_throttle_count++;
+        }
+
+        /*
+         * No timeslices, only preempt for higher priority processes,
+         * or for normal processes if we were just throttled.
+         */
+        if (scheduler_top_level() == curr->sched_level) {
+            return;
+        }
+    } else if (curr->pid > 0) {
+        if (++curr->sched_ticks >= scheduler_slice_ticks(curr)) {
+            level = curr->sched_level;
+            if (level - scheduler_base_level(curr) < SCHEDULER_MAX_DEMOTIONS) {
+                scheduler_stats[level].demotions++;
+                scheduler_dequeue(curr);
+                scheduler_enqueue(curr, level + 1);
+            }
+            scheduler_yield();
+            return;
+        }
+
+        /* Preempt if a higher priority process became runnable */
+        if (scheduler_top_level() >= curr->sched_level) {
+            return;
+        }
+    }
+
+    scheduler_yield();
+}
+
+/*
+ * nice() syscall handler. Adds inc to the nice value of the
+ * calling process and returns the new nice value. Higher nice
+ * values mean lower priority. The result is clamped to the
+ * range [NICE_MIN, NICE_MAX].
+ */
+__cdecl int
+scheduler_nice(int inc)
+{
+    pcb_t *pcb = get_executing_pcb();
+    assert(pcb->pid > 0);
+
+    /* Clamp inc first to avoid overflow */
+    inc = min(max(inc, NICE_MIN - NICE_MAX), NICE_MAX - NICE_MIN);
+    pcb->nice = min(max(pcb->nice + inc, NICE_MIN), NICE_MAX);
+
+    /* Move to the new base level */
+    scheduler_dequeue(pcb);
+    scheduler_enqueue(pcb, scheduler_base_level(pcb));
+    return pcb->nice;
+}
+
+/*
+ * rtprio() syscall handler. Sets the real-time priority of the
+ * calling process. Real-time processes always run before normal
+ * processes, and are only preempted by real-time processes with
+ * a higher priority; processes with the same priority run in
+ * first in, first out order. If prio is 0, the process goes back
+ * to being a normal process. The real-time priority is not
+ * inherited by children. Returns 0 on success, -1 if prio is not
+ * in the range [0, RTPRIO_MAX].
+ */
+__cdecl int
+scheduler_rtprio(int prio)
+{
+    if (prio < 0 || prio > RTPRIO_MAX) {
+        debugf("Invalid real-time priority: %d\n", prio);
+        return -1;
+    }
+
+    pcb_t *pcb = get_executing_pcb();
+    assert(pcb->pid > 0);
+    pcb->rtprio = prio;
+    scheduler_dequeue(pcb);
+    scheduler_enqueue(pcb, scheduler_base_level(pcb));
+    return 0;
+}
+
+/*
+ * Prints the statistics of every priority level.
+ */
+void
+scheduler_dump_state(void)
+{
+    printf("--- SCHEDULER STATE BEGIN ---\n");
+    printf(
+        "ticks=%u rt_ticks=%d rt_throttled=%u\n",
+        scheduler_ticks,
+        scheduler_rt_ticks,
+        scheduler_rt_throttle_count);
+    int level;
+    for (level = 0; level < SCHEDULER_NUM_LEVELS; ++level) {
+        scheduler_stats_t *stats = &scheduler_stats[level];
+        uint32_t avg = 0, avg_frac = 0;
+        if (scheduler_ticks > 0) {
+            avg = stats->len_sum / scheduler_ticks;
+            avg_frac = (stats->len_sum % scheduler_ticks) * 10 / scheduler_ticks;
+        }
+        printf(
+            "%d: len=%d max=%d avg=%u.%u picks=%u demotions=%u\n",
+            level,
+            stats->len,
+            stats->max_len,
+            avg,
+            avg_frac,
+            stats->picks,
+            stats->demotions);
+    }
+}
+
+/*
+ * Initializes the scheduler queues.
+ */
+void
+scheduler_init(void)
+{
+    int level;
+    for (level = 0; level < SCHEDULER_NUM_LEVELS; ++level) {
+        list_init(&scheduler_queues[level]);
+    }
 }
 
 /*
@@ -4,6 +4,13 @@
 #include "types.h"
 #include "process.h"
 
+/* Range of nice values; lower values mean higher priority */
+#define NICE_MIN (-4)
+#define NICE_MAX 3
+
+/* Highest real-time priority; 0 means not real-time */
+#define RTPRIO_MAX 4
+
 #ifndef ASM
 
 /* Yields the current process's timeslice */
@@ -25,6 +32,24 @@ void scheduler_sleep_with_timeout(int timeout);
 /* Wakes the specified process */
 void scheduler_wake(pcb_t *pcb);
 
+/* Handles a timer tick, preempting the current process if necessary */
+void scheduler_tick(void);
+
+/* Returns whether timer ticks are needed for timeslicing */
+bool scheduler_needs_tick(void);
+
+/* nice() syscall handler */
+__cdecl int scheduler_nice(int inc);
+
+/* rtprio() syscall handler */
+__cdecl int scheduler_rtprio(int prio);
+
+/* Prints the state of the scheduler queues */
+void scheduler_dump_state(void);
+
+/* Initializes the scheduler */
+void scheduler_init(void);
+
 #endif /* ASM */
 
 #endif /* _SCHEDULER_H */
@@ -0,0 +1,297 @@
+#include "shm.h"
+#include "types.h"
+#include "debug.h"
+#include "math.h"
+#include "string.h"
+#include "list.h"
+#include "myalloc.h"
+#include "paging.h"
+#include "file.h"
+
+/* Maximum size of a single segment (the size of the mmap region) */
+#define MAX_SHM_SIZE ((int)(USER_MMAP_END - USER_MMAP_START))
+
+/* List of segments that have a name */
+static list_define(shm_named_list);
+
+/* Forward declaration */
+static const file_ops_t shm_fops;
+
+/*
+ * Returns the number of frames needed to hold a segment
+ * of the specified size.
+ */
+static int
+shm_num_frames(int size)
+{
+    return div_round_up(size, FRAME_SIZE);
+}
+
+/*
+ * Finds a named segment, returning NULL if it does not exist.
+ */
+static shm_t *
+shm_find(const char *name)
+{
+    list_t *pos;
+    list_for_each(pos, &shm_named_list) {
+        shm_t *shm = list_entry(pos, shm_t, list);
+        if (strcmp(shm->name, name) == 0) {
+            return shm;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Releases the frames in a segment starting at the
+ * specified index.
+ */
+static void
+shm_free_frames(shm_t *shm, int start)
+{
+    int i;
+    for (i = start; i < shm_num_frames(shm->size); ++i) {
+        if (shm->frames[i] != 0) {
+            paging_frame_free(shm->frames[i]);
+            shm->frames[i] = 0;
+        }
+    }
+}
+
+/*
+ * Allocates a new segment with the specified name (which may
+ * be empty for anonymous segments) and size. The segment starts
+ * with a reference count of 1. Returns NULL on failure.
+ */
+static shm_t *
+shm_alloc(const char *name, int size)
+{
+    shm_t *shm = malloc(sizeof(shm_t));
+    if (shm == NULL) {
+        debugf("Cannot allocate shared memory segment\n");
+        return NULL;
+    }
+
+    shm->frames = calloc(shm_num_frames(size), sizeof(uintptr_t));
+    if (shm->frames == NULL && size > 0) {
+        debugf("Cannot allocate shared memory frame array\n");
+        free(shm);
+        return NULL;
+    }
+
+    strcpy(shm->name, name);
+    shm->refcnt = 1;
+    shm->mapcnt = 0;
+    shm->size = size;
+    if (name[0] != '\0') {
+        list_add(&shm->list, &shm_named_list);
+    } else {
+        list_init(&shm->list);
+    }
+    return shm;
+}
+
+/*
+ * Increments the reference count of a segment.
+ */
+static shm_t *
+shm_retain(shm_t *shm)
+{
+    assert(shm->refcnt < INT_MAX);
+    shm->refcnt++;
+    return shm;
+}
+
+/*
+ * Decrements the reference count of a segment, freeing it
+ * (and its name) once nobody references it anymore.
+ */
+static void
+shm_release(shm_t *shm)
+{
+    assert(shm->refcnt > 0);
+    if (--shm->refcnt > 0) {
+        return;
+    }
+
+    assert(shm->mapcnt == 0);
+    list_del(&shm->list);
+    shm_free_frames(shm, 0);
+    free(shm->frames);
+    free(shm);
+}
+
+/*
+ * Returns the segment referenced by the specified file,
+ * or NULL if the file is not a shared memory segment.
+ */
+shm_t *
+shm_from_file(file_obj_t *file)
+{
+    if (file->ops_table != &shm_fops) {
+        return NULL;
+    }
+    return (shm_t *)file->private;
+}
+
+/*
+ * Marks a segment as being mapped into memory. The segment
+ * cannot be resized until it is unmapped.
+ */
+shm_t *
+shm_map(shm_t *shm)
+{
+    shm->mapcnt++;
+    return shm_retain(shm);
+}
+
+/*
+ * Releases a mapping obtained from shm_map().
+ */
+void
+shm_unmap(shm_t *shm)
+{
+    assert(shm->mapcnt > 0);
+    shm->mapcnt--;
+    shm_release(shm);
+}
+
+/*
+ * Returns the physical address of the frame at the specified
+ * index in the segment, allocating it (filled with zeros) if
+ * necessary. The caller gets a new reference to the frame,
+ * which must be released with paging_frame_free(). Returns 0
+ * if there is not enough memory.
+ */
+uintptr_t
+shm_get_frame(shm_t *shm, int index)
+{
+    assert(index >= 0 && index < shm_num_frames(shm->size));
+
+    if (shm->frames[index] == 0) {
+        shm->frames[index] = paging_frame_alloc_zeroed();
+        if (shm->frames[index] == 0) {
+            debugf("Cannot allocate shared memory frame\n");
+            return 0;
+        }
+    }
+
+    return paging_frame_retain(shm->frames[index]);
+}
+
+/*
+ * truncate() syscall handler for shared memory segments.
+ * Changes the size of the segment; new space is filled with
+ * zeros. Segments cannot be resized while they are mapped.
+ */
+static int
+shm_truncate(file_obj_t *file, int length)
+{
+    shm_t *shm = (shm_t *)file->private;
+    if (length < 0 || length > MAX_SHM_SIZE) {
+        return -1;
+    }
+
+    if (shm->mapcnt > 0) {
+        debugf("Cannot resize shared memory segment while mapped\n");
+        return -1;
+    }
+
+    int old_frames = shm_num_frames(shm->size);
+    int new_frames = shm_num_frames(length);
+    if (new_frames < old_frames) {
+        shm_free_frames(shm, new_frames);
+    }
+
+    if (new_frames != old_frames) {
+        uintptr_t *frames = realloc(shm->frames, new_frames * sizeof(uintptr_t));
+        if (frames == NULL && new_frames > 0) {
+            debugf("Cannot resize shared memory frame array\n");
+            return -1;
+        }
+
+        if (new_frames > old_frames) {
+            memset(&frames[old_frames], 0, (new_frames - old_frames) * sizeof(uintptr_t));
+        }
+        shm->frames = frames;
+    }
+
+    /* Clear the tail of the last frame, in case we're growing */
+    int tail = shm->size % FRAME_SIZE;
+    if (length > shm->size && tail != 0 && shm->frames[shm->size / FRAME_SIZE] != 0) {
+        uint8_t *frame = paging_phys_to_virt(shm->frames[shm->size / FRAME_SIZE]);
+        memset(&frame[tail], 0, FRAME_SIZE - tail);
+    }
+
+    shm->size = length;
+    return 0;
+}
+
+/*
+ * close() syscall handler for shared memory segments.
+ */
+static void
+shm_close(file_obj_t *file)
+{
+    shm_t *shm = (shm_t *)file->private;
+    if (shm != NULL) {
+        shm_release(shm);
+    }
+}
+
+/* File ops for shared memory segments */
+static const file_ops_t shm_fops = {
+    .truncate = shm_truncate,
+    .close = shm_close,
+};
+
+/*
+ * shmopen() syscall handler. Opens the shared memory segment
+ * with the specified name, creating it with the specified size
+ * if it does not exist yet (in which case size is ignored).
+ * If name is NULL, a new anonymous segment is created. Returns
+ * a file descriptor referring to the segment, which can be
+ * mapped using mmap(). Named segments are destroyed once there
+ * are no more descriptors or mappings referencing them.
+ */
+__cdecl int
+shm_shmopen(const char *name, int size)
+{
+    char kname[MAX_SHM_NAME_LEN + 1];
+    kname[0] = '\0';
+    if (name != NULL && strscpy_from_user(kname, name, sizeof(kname)) < 0) {
+        debugf("Invalid shared memory segment name\n");
+        return -1;
+    }
+
+    if (size < 0 || size > MAX_SHM_SIZE) {
+        debugf("Invalid shared memory segment size: %d\n", size);
+        return -1;
+    }
+
+    shm_t *shm = NULL;
+    if (kname[0] != '\0') {
+        shm = shm_find(kname);
+    }
+
+    if (shm != NULL) {
+        shm_retain(shm);
+    } else {
+        shm = shm_alloc(kname, size);
+        if (shm == NULL) {
+            return -1;
+        }
+    }
+
+    file_obj_t *file = file_obj_alloc(&shm_fops, OPEN_RDWR);
+    if (file == NULL) {
+        shm_release(shm);
+        return -1;
+    }
+
+    file->private = (intptr_t)shm;
+    int fd = file_desc_bind(get_executing_files(), -1, file);
+    file_obj_release(file);
+    return fd;
+}
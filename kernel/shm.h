@@ -0,0 +1,53 @@
+#ifndef _SHM_H
+#define _SHM_H
+
+#include "types.h"
+#include "list.h"
+#include "file.h"
+
+/* Maximum length of a shared memory segment name */
+#define MAX_SHM_NAME_LEN 32
+
+#ifndef ASM
+
+/*
+ * Shared memory segment. The frames backing the segment are
+ * allocated when they are first mapped, and are shared by all
+ * address spaces that map the segment.
+ */
+typedef struct shm {
+    /* Node in the list of named segments */
+    list_t list;
+
+    /* Name of the segment, empty if anonymous */
+    char name[MAX_SHM_NAME_LEN + 1];
+
+    /* Number of file objects and mappings referencing the segment */
+    int refcnt;
+
+    /* Number of address space mappings of the segment */
+    int mapcnt;
+
+    /* Size of the segment in bytes */
+    int size;
+
+    /* Physical address of each frame, or 0 if not allocated yet */
+    uintptr_t *frames;
+} shm_t;
+
+/* Gets the segment referenced by a file, or NULL if not a segment */
+shm_t *shm_from_file(file_obj_t *file);
+
+/* Prevents a segment from being resized while it is mapped */
+shm_t *shm_map(shm_t *shm);
+void shm_unmap(shm_t *shm);
+
+/* Gets a new reference to a frame of the segment */
+uintptr_t shm_get_frame(shm_t *shm, int index);
+
+/* shmopen() syscall handler */
+__cdecl int shm_shmopen(const char *name, int size);
+
+#endif /* ASM */
+
+#endif /* _SHM_H */
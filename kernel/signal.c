@@ -234,7 +234,7 @@ static int
 signal_kill_one(int pid, int signum)
 {
     pcb_t *pcb = get_pcb(pid);
-    if (pcb == NULL || pcb->state == PROCESS_STATE_ZOMBIE) {
+    if (pcb == NULL || pcb->state == PROCESS_STATE_ZOMBIE || pcb->kthread != NULL) {
         return -1;
     }
 
@@ -253,7 +253,7 @@ signal_kill_group(int pgid, int signum)
     int ret = -1;
     pcb_t *pcb;
     process_for_each(pcb) {
-        if (pcb->group == pgid) {
+        if (pcb->group == pgid && pcb->kthread == NULL) {
             ret = 0;
             signal_raise(pcb, signum);
         }
@@ -266,7 +266,7 @@ signal_kill_group(int pgid, int signum)
  * signum to the specified process. If pid < 0, sends the signal
  * to every process in the process group with pgid == -pid. If
  * pid == 0, sends the signal to every process in the calling
- * process's group.
+ * process's group. Kernel threads cannot be sent signals.
  */
 __cdecl int
 signal_kill(int pid, int signum)
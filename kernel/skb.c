@@ -2,11 +2,28 @@
 #include "types.h"
 #include "debug.h"
 #include "string.h"
-#include "myalloc.h"
+#include "slab.h"
 
 /* 1500 bytes for Ethernet body + 14 byte Ethernet header */
 #define SKB_MAX_LEN 1514
 
+/* Large enough for ARP packets and TCP control segments */
+#define SKB_SMALL_LEN 128
+
+/* Object caches for small and full-size SKBs */
+static slab_cache_define(skb_small_cache, sizeof(skb_t) + SKB_SMALL_LEN, NULL);
+static slab_cache_define(skb_large_cache, sizeof(skb_t) + SKB_MAX_LEN, NULL);
+
+/*
+ * Returns the cache that SKBs with the specified buffer
+ * size are allocated from.
+ */
+static slab_cache_t *
+skb_cache(int size)
+{
+    return (size <= SKB_SMALL_LEN) ? &skb_small_cache : &skb_large_cache;
+}
+
 /*
  * Allocates and initializes a new SKB. Returns NULL if
  * we ran out of memory. The new SKB has reference count
@@ -16,7 +33,7 @@ skb_t *
 skb_alloc(int size)
 {
     assert(size >= 0 && size <= SKB_MAX_LEN);
-    skb_t *skb = malloc(sizeof(skb_t) + size);
+    skb_t *skb = slab_alloc(skb_cache(size));
     if (skb == NULL) {
         return NULL;
     }
@@ -57,7 +74,7 @@ skb_release(skb_t *skb)
 {
     assert(skb->refcnt > 0);
     if (--skb->refcnt == 0) {
-        free(skb);
+        slab_free(skb_cache(skb->end), skb);
     }
 }
 
@@ -68,7 +85,7 @@ skb_release(skb_t *skb)
 skb_t *
 skb_clone(skb_t *skb)
 {
-    skb_t *clone = malloc(sizeof(skb_t) + skb->end);
+    skb_t *clone = slab_alloc(skb_cache(skb->end));
     if (clone == NULL) {
         return NULL;
     }
@@ -0,0 +1,235 @@
+#include "slab.h"
+#include "types.h"
+#include "debug.h"
+#include "math.h"
+#include "list.h"
+#include "paging.h"
+#include "printf.h"
+
+/* Alignment of objects within a slab */
+#define SLAB_ALIGN 8
+
+/* Try to fit at least this many objects in each slab */
+#define SLAB_MIN_OBJS 8
+
+/* Largest slab is 2^SLAB_MAX_ORDER frames */
+#define SLAB_MAX_ORDER 3
+
+/*
+ * Header at the start of each slab. Slabs are naturally
+ * aligned buddy blocks, so the header of the slab holding
+ * an object is found by rounding down the object's address.
+ */
+typedef struct {
+    /* Node in the cache's partial/empty/full list */
+    list_t list;
+
+    /* Cache that this slab belongs to */
+    slab_cache_t *cache;
+
+    /* Number of allocated objects in this slab */
+    int inuse;
+
+    /* First free object in this slab, or NULL if full */
+    void *free;
+} slab_t;
+
+/* Offset of the first object from the start of the slab */
+#define SLAB_HEADER_SIZE round_up(sizeof(slab_t), SLAB_ALIGN)
+
+/* List of all caches that have been used */
+static list_define(slab_caches);
+
+/*
+ * Returns a pointer to the free list link of an object. If the
+ * cache has a constructor, the link is stored after the object
+ * so that it does not clobber the constructed state.
+ */
+static void **
+slab_free_link(slab_cache_t *cache, void *obj)
+{
+    if (cache->ctor != NULL) {
+        return (void **)((uint8_t *)obj + round_up(cache->obj_size, sizeof(void *)));
+    } else {
+        return (void **)obj;
+    }
+}
+
+/*
+ * Computes the layout of slabs in the cache. Uses the smallest
+ * slab size that fits SLAB_MIN_OBJS objects.
+ */
+static void
+slab_cache_init(slab_cache_t *cache)
+{
+    int size = max(cache->obj_size, (int)sizeof(void *));
+    if (cache->ctor != NULL) {
+        size = round_up(cache->obj_size, sizeof(void *)) + sizeof(void *);
+    }
+    cache->stride = round_up(size, SLAB_ALIGN);
+
+    int order;
+    for (order = 0; order < SLAB_MAX_ORDER; ++order) {
+        int slab_size = FRAME_SIZE << order;
+        if ((slab_size - (int)SLAB_HEADER_SIZE) / cache->stride >= SLAB_MIN_OBJS) {
+            break;
+        }
+    }
+
+    cache->order = order;
+    cache->objs_per_slab = ((FRAME_SIZE << order) - SLAB_HEADER_SIZE) / cache->stride;
+    assert(cache->objs_per_slab > 0);
+    list_add_tail(&cache->list, &slab_caches);
+}
+
+/*
+ * Allocates a new slab for the cache, constructs all of its
+ * objects, and adds it to the empty list. Returns NULL if
+ * there is not enough memory.
+ */
+static slab_t *
+slab_grow(slab_cache_t *cache)
+{
+    if (cache->order < 0) {
+        slab_cache_init(cache);
+    }
+
+    uintptr_t paddr = paging_block_alloc(cache->order);
+    if (paddr == 0) {
+        debugf("Cannot allocate slab for %s\n", cache->name);
+        return NULL;
+    }
+
+    slab_t *slab = paging_phys_to_virt(paddr);
+    slab->cache = cache;
+    slab->inuse = 0;
+    slab->free = NULL;
+
+    /* Build the free list backwards so objects are handed out in order */
+    uint8_t *objs = (uint8_t *)slab + SLAB_HEADER_SIZE;
+    int i;
+    for (i = cache->objs_per_slab - 1; i >= 0; --i) {
+        void *obj = &objs[i * cache->stride];
+        if (cache->ctor != NULL) {
+            cache->ctor(obj);
+        }
+        *slab_free_link(cache, obj) = slab->free;
+        slab->free = obj;
+    }
+
+    list_add(&slab->list, &cache->empty);
+    cache->num_slabs++;
+    return slab;
+}
+
+/*
+ * Returns a slab to the page allocator. The slab must not
+ * have any allocated objects.
+ */
+static void
+slab_destroy(slab_cache_t *cache, slab_t *slab)
+{
+    assert(slab->inuse == 0);
+    list_del(&slab->list);
+    cache->num_slabs--;
+
+    uintptr_t paddr = (uintptr_t)slab - PHYSMAP_START;
+    paging_block_free(paddr, cache->order);
+}
+
+/*
+ * Allocates an object from the cache. If the cache has a
+ * constructor, the object is in its constructed state;
+ * otherwise, its contents are undefined. Returns NULL if
+ * there is not enough memory.
+ */
+void *
+slab_alloc(slab_cache_t *cache)
+{
+    slab_t *slab;
+    if (!list_empty(&cache->partial)) {
+        slab = list_first_entry(&cache->partial, slab_t, list);
+    } else if (!list_empty(&cache->empty)) {
+        slab = list_first_entry(&cache->empty, slab_t, list);
+    } else {
+        slab = slab_grow(cache);
+        if (slab == NULL) {
+            return NULL;
+        }
+    }
+
+    void *obj = slab->free;
+    assert(obj != NULL);
+    slab->free = *slab_free_link(cache, obj);
+    slab->inuse++;
+
+    if (slab->inuse == cache->objs_per_slab) {
+        list_del(&slab->list);
+        list_add(&slab->list, &cache->full);
+    } else if (slab->inuse == 1) {
+        list_del(&slab->list);
+        list_add(&slab->list, &cache->partial);
+    }
+
+    cache->num_active++;
+    cache->num_allocs++;
+    return obj;
+}
+
+/*
+ * Returns an object to the cache it was allocated from. Each
+ * cache holds on to one completely free slab to avoid
+ * thrashing; any other free slabs are released back to the
+ * page allocator.
+ */
+void
+slab_free(slab_cache_t *cache, void *obj)
+{
+    if (obj == NULL) {
+        return;
+    }
+
+    uintptr_t slab_size = FRAME_SIZE << cache->order;
+    slab_t *slab = (slab_t *)round_down((uintptr_t)obj, slab_size);
+    assert(slab->cache == cache);
+    assert(slab->inuse > 0);
+
+    *slab_free_link(cache, obj) = slab->free;
+    slab->free = obj;
+    slab->inuse--;
+    cache->num_active--;
+    cache->num_frees++;
+
+    if (slab->inuse == 0) {
+        if (list_empty(&cache->empty)) {
+            list_del(&slab->list);
+            list_add(&slab->list, &cache->empty);
+        } else {
+            slab_destroy(cache, slab);
+        }
+    } else if (slab->inuse == cache->objs_per_slab - 1) {
+        list_del(&slab->list);
+        list_add(&slab->list, &cache->partial);
+    }
+}
+
+/*
+ * Prints the statistics of every cache that has been used.
+ */
+void
+slab_dump_state(void)
+{
+    printf("--- SLAB STATE BEGIN ---\n");
+    list_t *pos;
+    list_for_each(pos, &slab_caches) {
+        slab_cache_t *cache = list_entry(pos, slab_cache_t, list);
+        printf(
+            "%s: size=%d slabs=%d active=%d allocs=%d frees=%d\n",
+            cache->name,
+            cache->obj_size,
+            cache->num_slabs,
+            cache->num_active,
+            cache->num_allocs,
+            cache->num_frees);
+    }
+}
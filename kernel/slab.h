@@ -0,0 +1,75 @@
+#ifndef _SLAB_H
+#define _SLAB_H
+
+#include "types.h"
+#include "list.h"
+
+#ifndef ASM
+
+/*
+ * Cache of fixed-size kernel objects. Objects are carved out
+ * of slabs (blocks of physical frames) and kept on per-slab
+ * free lists, so allocation and deallocation are O(1) and
+ * never touch the general-purpose heap.
+ */
+typedef struct {
+    /* Node in the list of all caches */
+    list_t list;
+
+    /* Name of the cache, for debugging */
+    const char *name;
+
+    /* Size of each object, as requested */
+    int obj_size;
+
+    /*
+     * Optional constructor called on each object when its slab
+     * is created. Objects must be returned to the cache in
+     * their constructed state.
+     */
+    void (*ctor)(void *obj);
+
+    /* Layout of each slab, computed when the first slab is created */
+    int order;
+    int stride;
+    int objs_per_slab;
+
+    /* Slabs with some, none, and all objects allocated */
+    list_t partial;
+    list_t empty;
+    list_t full;
+
+    /* Statistics */
+    int num_slabs;
+    int num_active;
+    int num_allocs;
+    int num_frees;
+} slab_cache_t;
+
+/*
+ * Defines a new empty object cache for objects of the
+ * specified size.
+ */
+#define slab_cache_define(name_, size, ctor_) \
+    slab_cache_t name_ = {                    \
+        .name = #name_,                       \
+        .obj_size = (size),                   \
+        .ctor = (ctor_),                      \
+        .order = -1,                          \
+        .partial = { .prev = &(name_).partial, .next = &(name_).partial }, \
+        .empty = { .prev = &(name_).empty, .next = &(name_).empty },       \
+        .full = { .prev = &(name_).full, .next = &(name_).full },          \
+    }
+
+/* Allocates an object from a cache */
+void *slab_alloc(slab_cache_t *cache);
+
+/* Returns an object to the cache it was allocated from */
+void slab_free(slab_cache_t *cache, void *obj);
+
+/* Prints the statistics of every cache */
+void slab_dump_state(void);
+
+#endif /* ASM */
+
+#endif /* _SLAB_H */
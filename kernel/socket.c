@@ -1,7 +1,7 @@
 #include "socket.h"
 #include "types.h"
 #include "debug.h"
-#include "myalloc.h"
+#include "slab.h"
 #include "file.h"
 #include "paging.h"
 #include "net.h"
@@ -20,6 +20,9 @@ static const sock_ops_t *sock_ops_tables[SOCK_TYPE_COUNT];
 /* Global list of sockets */
 static list_define(socket_list);
 
+/* Object cache for sockets */
+static slab_cache_define(net_sock_cache, sizeof(net_sock_t), NULL);
+
 /* File operations syscall forward declarations */
 static int socket_read(file_obj_t *file, void *buf, int nbytes);
 static int socket_write(file_obj_t *file, const void *buf, int nbytes);
@@ -95,7 +98,7 @@ socket_obj_free(net_sock_t *sock, bool call_dtor)
         sock->ops_table->dtor(sock);
     }
     list_del(&sock->list);
-    free(sock);
+    slab_free(&net_sock_cache, sock);
 }
 
 /*
@@ -117,7 +120,7 @@ socket_obj_alloc(int type)
         goto error;
     }
 
-    sock = malloc(sizeof(net_sock_t));
+    sock = slab_alloc(&net_sock_cache);
     if (sock == NULL) {
         debugf("Failed to allocate space for socket object\n");
         ret = NULL;
@@ -655,3 +655,17 @@ ctz(unsigned int x)
     asm("bsfl %1, %0" : "=r"(i) : "g"(x) : "cc");
     return i;
 }
+
+/*
+ * Returns the number of leading zero bits in x.
+ * x must not be zero.
+ */
+int
+clz(unsigned int x)
+{
+    assert(x != 0);
+
+    int i;
+    asm("bsrl %1, %0" : "=r"(i) : "g"(x) : "cc");
+    return 31 - i;
+}
@@ -51,7 +51,15 @@
 #define SYS_FBUNMAP     47
 #define SYS_FBFLIP      48
 #define SYS_POLL        49
-#define NUM_SYSCALL     49
+#define SYS_SPAWN       50
+#define SYS_MMAP        51
+#define SYS_MUNMAP      52
+#define SYS_SHMOPEN     53
+#define SYS_NICE        54
+#define SYS_RTPRIO      55
+#define SYS_CLONE       56
+#define SYS_FUTEX       57
+#define NUM_SYSCALL     57
 
 #ifndef ASM
 
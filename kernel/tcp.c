@@ -16,7 +16,7 @@
 #include "file.h"
 #include "pit.h"
 #include "timer.h"
-#include "myalloc.h"
+#include "slab.h"
 #include "socket.h"
 #include "paging.h"
 #include "net.h"
@@ -25,6 +25,7 @@
 #include "rand.h"
 #include "wait.h"
 #include "poll.h"
+#include "defer.h"
 
 /*
  * Enable for verbose TCP logging. Warning: very verbose.
@@ -280,6 +281,30 @@ typedef struct {
 /* List of TCP sockets that have an ACK enqueued */
 static list_define(tcp_ack_queue);
 
+/*
+ * Slab constructor for TCP socket state. The queues and timers
+ * are always empty and inactive again by the time the socket
+ * is destroyed, so they only need to be set up once.
+ */
+static void
+tcp_sock_init(void *obj)
+{
+    tcp_sock_t *tcp = obj;
+    list_init(&tcp->backlog);
+    list_init(&tcp->inbox);
+    list_init(&tcp->outbox);
+    list_init(&tcp->ack_queue);
+    list_init(&tcp->accept_queue);
+    list_init(&tcp->read_queue);
+    list_init(&tcp->write_queue);
+    timer_init(&tcp->fin_timer);
+    timer_init(&tcp->rto_timer);
+}
+
+/* Object caches for TCP socket state and outbox packets */
+static slab_cache_define(tcp_sock_cache, sizeof(tcp_sock_t), tcp_sock_init);
+static slab_cache_define(tcp_pkt_cache, sizeof(tcp_pkt_t), NULL);
+
 /* Forward declaration */
 static void tcp_start_rto_timeout(tcp_sock_t *tcp);
 
@@ -679,26 +704,32 @@ tcp_init_remote_seq(tcp_sock_t *tcp, uint32_t seq_num)
 }
 
 /*
- * Adds a socket to the pending ACK queue. ACKs are sent at the
- * end of an interrupt, which lets us merge ACKs for packets received
- * in the same interrupt.
+ * Adds a socket to the pending ACK queue. ACKs are sent as
+ * deferred work after received packets have been processed,
+ * which lets us merge ACKs for packets received together.
  */
 static void
 tcp_enqueue_ack(tcp_sock_t *tcp)
 {
     if (list_empty(&tcp->ack_queue)) {
         list_add(&tcp->ack_queue, &tcp_ack_queue);
+        defer_raise(DEFER_TCP_ACK);
     }
 }
 
 /*
- * Delivers all pending ACKs.
+ * Delivers up to budget pending ACKs. Returns whether there
+ * are still ACKs to be sent.
  */
-void
-tcp_deliver_ack(void)
+static bool
+tcp_deliver_ack(int budget)
 {
     list_t *pos, *next;
     list_for_each_safe(pos, next, &tcp_ack_queue) {
+        if (budget-- <= 0) {
+            return true;
+        }
+
         tcp_sock_t *tcp = tcp_acquire(list_entry(pos, tcp_sock_t, ack_queue));
         if (!tcp_in_state(tcp, CLOSED)) {
             tcp_send_ack(tcp);
@@ -706,6 +737,7 @@ tcp_deliver_ack(void)
         list_del(&tcp->ack_queue);
         tcp_release(tcp);
     }
+    return false;
 }
 
 /*
@@ -885,7 +917,7 @@ tcp_start_rto_timeout(tcp_sock_t *tcp)
 static tcp_pkt_t *
 tcp_outbox_insert(tcp_sock_t *tcp, skb_t *skb)
 {
-    tcp_pkt_t *pkt = malloc(sizeof(tcp_pkt_t));
+    tcp_pkt_t *pkt = slab_alloc(&tcp_pkt_cache);
     if (pkt == NULL) {
         return NULL;
     }
@@ -969,7 +1001,7 @@ tcp_outbox_remove(tcp_sock_t *tcp, tcp_pkt_t *pkt)
     tcp_debugf(tcp, "Removing %p from outbox\n", pkt);
     list_del(&pkt->list);
     skb_release(pkt->skb);
-    free(pkt);
+    slab_free(&tcp_pkt_cache, pkt);
 }
 
 /*
@@ -1635,8 +1667,8 @@ tcp_handle_new_connection(net_iface_t *iface, tcp_sock_t *tcp, skb_t *skb)
     /* Add socket to backlog for accept() */
     tcp_add_backlog(tcp, conntcp);
 
-    /* Wake anyone blocking on an accept() call */
-    wait_queue_wake(&tcp->accept_queue);
+    /* Wake one process blocking on an accept() call */
+    wait_queue_wake_one(&tcp->accept_queue);
 
     ret = 0;
 
@@ -1757,7 +1789,7 @@ tcp_handle_rx(net_iface_t *iface, skb_t *skb)
 static int
 tcp_ctor(net_sock_t *sock)
 {
-    tcp_sock_t *tcp = malloc(sizeof(tcp_sock_t));
+    tcp_sock_t *tcp = slab_alloc(&tcp_sock_cache);
     if (tcp == NULL) {
         debugf("Cannot allocate space for TCP data\n");
         return -1;
@@ -1766,15 +1798,6 @@ tcp_ctor(net_sock_t *sock)
     uint32_t seq = urand();
     tcp->sock = sock;
     tcp->state = CLOSED;
-    list_init(&tcp->backlog);
-    list_init(&tcp->inbox);
-    list_init(&tcp->outbox);
-    list_init(&tcp->ack_queue);
-    list_init(&tcp->accept_queue);
-    list_init(&tcp->read_queue);
-    list_init(&tcp->write_queue);
-    timer_init(&tcp->fin_timer);
-    timer_init(&tcp->rto_timer);
     tcp->backlog_capacity = 256;
     tcp->recv_wnd_size = TCP_INIT_WND_SIZE;
     tcp->recv_read_num = 0;
@@ -1854,7 +1877,11 @@ tcp_dtor(net_sock_t *sock)
     timer_cancel(&tcp->fin_timer);
     timer_cancel(&tcp->rto_timer);
 
-    free(tcp);
+    /* Return to the cache in the state tcp_sock_init() left it */
+    assert(list_empty(&tcp->backlog));
+    assert(list_empty(&tcp->inbox));
+    assert(list_empty(&tcp->outbox));
+    slab_free(&tcp_sock_cache, tcp);
 }
 
 /*
@@ -2012,7 +2039,7 @@ tcp_accept(net_sock_t *sock, sock_addr_t *addr)
     tcp_sock_t *tcp = tcp_acquire(tcp_sock(sock));
 
     /* Wait for an incoming connection */
-    ret = WAIT_INTERRUPTIBLE(
+    ret = WAIT_INTERRUPTIBLE_EXCLUSIVE(
         tcp_can_accept(tcp),
         &tcp->accept_queue,
         socket_is_nonblocking(sock));
@@ -2044,6 +2071,10 @@ tcp_accept(net_sock_t *sock, sock_addr_t *addr)
 
 exit:
     if (tcp != NULL) {
+        /* Let the next accept() caller have any remaining connections */
+        if (!list_empty(&tcp->backlog)) {
+            wait_queue_wake_one(&tcp->accept_queue);
+        }
         tcp_release(tcp);
     }
     return ret;
@@ -2428,5 +2459,6 @@ static const sock_ops_t sops_tcp = {
 void
 tcp_init(void)
 {
+    defer_register(DEFER_TCP_ACK, tcp_deliver_ack);
     socket_register_type(SOCK_TCP, &sops_tcp);
 }
@@ -7,9 +7,6 @@
 
 #ifndef ASM
 
-/* Delivers all pending ACKs */
-void tcp_deliver_ack(void);
-
 /* Handles reception of a TCP packet */
 int tcp_handle_rx(net_iface_t *iface, skb_t *skb);
 
@@ -9,7 +9,11 @@
 #include "wait.h"
 #include "vga.h"
 #include "myalloc.h"
+#include "slab.h"
+#include "scheduler.h"
 #include "poll.h"
+#include "defer.h"
+#include "kthread.h"
 
 /*
  * Executing terminal: the terminal corresponding to the currently
@@ -357,6 +361,22 @@ terminal_clear(void)
     term->mouse_input.count = 0;
 }
 
+/*
+ * Returns whether the keyboard input buffer holds a complete
+ * line, i.e. a newline or EOT character.
+ */
+static bool
+terminal_tty_has_line(kbd_input_buf_t *input_buf)
+{
+    int i;
+    for (i = 0; i < input_buf->count; ++i) {
+        if (input_buf->buf[i] == '\n' || input_buf->buf[i] == EOT) {
+            return true;
+        }
+    }
+    return false;
+}
+
 /*
  * Checks if the keyboard input buffer has enough data to be
  * read. Returns the number of characters that should be read,
@@ -418,7 +438,7 @@ terminal_tty_read(file_obj_t *file, void *buf, int nbytes)
     kbd_input_buf_t *input_buf = &term->kbd_input;
 
     /* Wait until there's a newline/EOT in the buffer */
-    nbytes = WAIT_INTERRUPTIBLE(
+    nbytes = WAIT_INTERRUPTIBLE_EXCLUSIVE(
         terminal_tty_get_readable_bytes(term, nbytes),
         &input_buf->read_queue,
         file->nonblocking);
@@ -444,6 +464,11 @@ terminal_tty_read(file_obj_t *file, void *buf, int nbytes)
         input_buf->count - nbytes);
     input_buf->count -= nbytes;
 
+    /* There may be another line ready, pass it on to the next reader */
+    if (terminal_tty_has_line(input_buf)) {
+        wait_queue_wake_one(&input_buf->read_queue);
+    }
+
     /* ncopy holds the number of characters copied */
     return ncopy;
 }
@@ -658,7 +683,7 @@ terminal_eof(void)
     kbd_input_buf_t *input_buf = &term->kbd_input;
     if (input_buf->count < array_len(input_buf->buf)) {
         input_buf->buf[input_buf->count++] = EOT;
-        wait_queue_wake(&input_buf->read_queue);
+        wait_queue_wake_one(&input_buf->read_queue);
     }
 }
 
@@ -681,6 +706,12 @@ handle_ctrl_input(kbd_input_ctrl_t ctrl)
         break;
     case KCTL_MEMDUMP:
         mya_dump_state();
+        slab_dump_state();
+        break;
+    case KCTL_SCHEDDUMP:
+        scheduler_dump_state();
+        defer_dump_state();
+        kthread_dump_state();
         break;
     case KCTL_TERM1:
     case KCTL_TERM2:
@@ -708,10 +739,12 @@ handle_char_input(char c)
         input_buf->buf[input_buf->count++] = c;
         terminal_putc_impl(term, c);
         terminal_update_cursor(term);
-    }
 
-    /* Wake all processes waiting on input to this terminal */
-    wait_queue_wake(&input_buf->read_queue);
+        /* Wake a process waiting for a line on this terminal */
+        if (c == '\n') {
+            wait_queue_wake_one(&input_buf->read_queue);
+        }
+    }
 }
 
 /* Handles input from the keyboard */
@@ -2,29 +2,125 @@
 #include "types.h"
 #include "debug.h"
 #include "list.h"
+#include "math.h"
 #include "pit.h"
 
-/* Global list of timers, in order of time until expiry */
-static list_define(timer_list);
+/*
+ * Timers are kept in a hierarchical timing wheel. Level 0 has
+ * one slot per millisecond; each slot in level n covers an entire
+ * revolution of level n - 1. When the lower levels wrap around,
+ * the timers in the next slot of the level above are redistributed
+ * ("cascaded") into the lower levels. This gives O(1) insertion
+ * and cancellation, and amortized O(1) work per millisecond.
+ */
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SIZE (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SIZE - 1)
+#define TIMER_WHEEL_LEVELS 4
+
+/* Longest delay that the wheel can represent (~4.6 hours) */
+#define TIMER_WHEEL_MAX_DELAY ((1 << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1)
+
+/* Timer wheel slots */
+static list_t timer_wheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];
+
+/*
+ * Time of the next millisecond that the wheel will process.
+ * All timers that expire before this have already been run.
+ */
+static int timer_wheel_time = 0;
+
+/*
+ * Returns the index of the slot in the specified level that
+ * covers the specified time.
+ */
+static int
+timer_wheel_index(int time, int level)
+{
+    return (time >> (level * TIMER_WHEEL_BITS)) & TIMER_WHEEL_MASK;
+}
 
 /*
- * Inserts a timer into its correct position in the global
- * timer list.
+ * Inserts a timer into the slot of the timer wheel
+ * corresponding to its expiry time.
  */
 static void
-timer_insert_list(timer_t *timer)
+timer_insert_wheel(timer_t *timer)
 {
     assert(timer != NULL);
     assert(timer->callback != NULL);
 
-    list_t *pos;
-    list_for_each_prev(pos, &timer_list) {
-        timer_t *qtimer = list_entry(pos, timer_t, list);
-        if (timer->when > qtimer->when) {
-            break;
+    /* Expired timers go in the next slot to be processed */
+    int delay = timer->when - timer_wheel_time;
+    int when = timer_wheel_time + clamp(delay, 0, TIMER_WHEEL_MAX_DELAY);
+    delay = when - timer_wheel_time;
+
+    /* Find the lowest level that can hold the delay */
+    int level = 0;
+    while (delay >> ((level + 1) * TIMER_WHEEL_BITS) != 0) {
+        level++;
+    }
+
+    list_add_tail(&timer->list, &timer_wheel[level][timer_wheel_index(when, level)]);
+}
+
+/*
+ * Redistributes the timers in the current slot of the
+ * specified level into the lower levels. Returns whether the
+ * level has also wrapped around, meaning the level above
+ * needs to be cascaded as well.
+ */
+static bool
+timer_cascade(int level)
+{
+    int index = timer_wheel_index(timer_wheel_time, level);
+
+    list_define(pending);
+    list_splice_tail_init(&timer_wheel[level][index], &pending);
+    while (!list_empty(&pending)) {
+        timer_t *timer = list_first_entry(&pending, timer_t, list);
+        list_del(&timer->list);
+        timer_insert_wheel(timer);
+    }
+
+    return index == 0;
+}
+
+/*
+ * Returns a lower bound on the monotonic time at which the
+ * next timer expires, or -1 if there are no active timers.
+ * If the next timer is still in an upper level of the wheel,
+ * this returns the time at which its slot will be cascaded.
+ */
+int
+timer_next_expiry(void)
+{
+    int next = -1;
+    int level;
+    for (level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+        int shift = level * TIMER_WHEEL_BITS;
+        int base = timer_wheel_time >> shift;
+
+        /*
+         * Once time has moved past the start of the current slot
+         * of an upper level, that slot has already been cascaded,
+         * so anything in it is one revolution away.
+         */
+        int start = (timer_wheel_time & ((1 << shift) - 1)) ? 1 : 0;
+        int end = start + TIMER_WHEEL_SIZE;
+        int i;
+        for (i = start; i < end; ++i) {
+            list_t *slot = &timer_wheel[level][(base + i) & TIMER_WHEEL_MASK];
+            if (!list_empty(slot)) {
+                int when = (base + i) << shift;
+                if (next < 0 || when < next) {
+                    next = when;
+                }
+                break;
+            }
         }
     }
-    list_add(&timer->list, pos);
+    return next;
 }
 
 /*
@@ -35,15 +131,32 @@ timer_tick(int now)
 {
     assert(now >= 0);
 
-    while (!list_empty(&timer_list)) {
-        timer_t *pending = list_first_entry(&timer_list, timer_t, list);
-        if (pending->when > now) {
-            break;
+    while (timer_wheel_time <= now) {
+        /* Cascade upper levels when the lower ones wrap around */
+        int level = 0;
+        while (level < TIMER_WHEEL_LEVELS - 1 &&
+               timer_wheel_index(timer_wheel_time, level) == 0 &&
+               timer_cascade(level + 1)) {
+            level++;
+        }
+
+        /*
+         * Advance time before running the callbacks, so that
+         * timers they set up for now go in the next slot rather
+         * than the one we're processing.
+         */
+        list_define(expired);
+        int index = timer_wheel_index(timer_wheel_time, 0);
+        list_splice_tail_init(&timer_wheel[0][index], &expired);
+        timer_wheel_time++;
+
+        while (!list_empty(&expired)) {
+            timer_t *pending = list_first_entry(&expired, timer_t, list);
+            list_del(&pending->list);
+            void (*callback)(timer_t *) = pending->callback;
+            pending->callback = NULL;
+            callback(pending);
         }
-        list_del(&pending->list);
-        void (*callback)(timer_t *) = pending->callback;
-        pending->callback = NULL;
-        callback(pending);
     }
 }
 
@@ -77,7 +190,7 @@ timer_clone(timer_t *dest, timer_t *src)
         /*
          * Since we know that the expiration times are the same,
          * we can just directly add the new timer immediately
-         * adjacent to the original one.
+         * adjacent to the original one, in the same wheel slot.
          */
         list_add(&dest->list, &src->list);
     }
@@ -115,7 +228,10 @@ timer_setup_abs(timer_t *timer, int when, void (*callback)(timer_t *))
     }
     timer->when = when;
     timer->callback = callback;
-    timer_insert_list(timer);
+    timer_insert_wheel(timer);
+
+    /* Make sure the PIT wakes us up in time */
+    pit_set_deadline(when);
 }
 
 /*
@@ -133,6 +249,20 @@ timer_cancel(timer_t *timer)
     }
 }
 
+/*
+ * Initializes the timer wheel.
+ */
+void
+timer_init_wheel(void)
+{
+    int level, i;
+    for (level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+        for (i = 0; i < TIMER_WHEEL_SIZE; ++i) {
+            list_init(&timer_wheel[level][i]);
+        }
+    }
+}
+
 /*
  * Returns whether a timer is currently active.
  */
@@ -27,6 +27,9 @@ typedef struct timer {
 /* Updates all active timers and runs callbacks upon expiry */
 void timer_tick(int now);
 
+/* Returns a lower bound on the expiry time of the next timer */
+int timer_next_expiry(void);
+
 /* Initializes a timer object */
 void timer_init(timer_t *timer);
 
@@ -45,6 +48,9 @@ void timer_cancel(timer_t *timer);
 /* Checks whether a timer is active */
 bool timer_is_active(timer_t *timer);
 
+/* Initializes the global timer wheel */
+void timer_init_wheel(void);
+
 #endif /* ASM */
 
 #endif /* _TIMER_H */
@@ -9,6 +9,7 @@
 #define EINTR  2
 #define EAGAIN 3
 #define EPIPE  4
+#define ENOENT 5
 
 #ifndef ASM
 
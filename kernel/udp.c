@@ -3,7 +3,7 @@
 #include "debug.h"
 #include "math.h"
 #include "list.h"
-#include "myalloc.h"
+#include "slab.h"
 #include "paging.h"
 #include "net.h"
 #include "ip.h"
@@ -39,6 +39,9 @@ typedef struct {
 #define udp_sock(sock) ((udp_sock_t *)(sock)->private)
 #define net_sock(ucp) ((ucp)->sock)
 
+/* Object cache for UDP socket state */
+static slab_cache_define(udp_sock_cache, sizeof(udp_sock_t), NULL);
+
 /*
  * Checks whether the specified incoming packet should be
  * accepted or dropped.
@@ -149,7 +152,7 @@ udp_send(net_sock_t *sock, skb_t *skb, ip_addr_t ip, uint16_t port)
 static int
 udp_ctor(net_sock_t *sock)
 {
-    udp_sock_t *udp = malloc(sizeof(udp_sock_t));
+    udp_sock_t *udp = slab_alloc(&udp_sock_cache);
     if (udp == NULL) {
         debugf("Cannot allocate space for UDP data\n");
         return -1;
@@ -175,7 +178,7 @@ udp_dtor(net_sock_t *sock)
     }
 
     /* Free the UDP data */
-    free(udp);
+    slab_free(&udp_sock_cache, udp);
 }
 
 /*
@@ -204,6 +204,9 @@ vbe_fbmap(void **ptr, int xres, int yres, int bpp)
         return -1;
     }
 
+    /* Claim the framebuffer before other processes can run below */
+    vbe_refcnt = 1;
+
     /* Update process page mapping */
     pcb_t *pcb = get_executing_pcb();
     pcb->fbmap = true;
@@ -223,8 +226,14 @@ vbe_fbmap(void **ptr, int xres, int yres, int bpp)
      */
     vga_save_text_mode();
 
-    /* Clear VBE page */
+    /*
+     * Clear VBE page. This takes a while, so enable interrupts
+     * meanwhile. The process may be preempted here, which is
+     * fine since the framebuffer is already ours.
+     */
+    asm volatile("sti" ::: "memory");
     memset((void *)VGA_VBE_PAGE_START, 0, VBE_FB_SIZE);
+    asm volatile("cli" ::: "memory");
 
     /* VBE must be disabled while we change xres/yres/bpp */
     vbe_set_register(VBE_DISPI_INDEX_ENABLE, 0);
@@ -238,8 +247,6 @@ vbe_fbmap(void **ptr, int xres, int yres, int bpp)
     vbe_set_register(VBE_DISPI_INDEX_X_OFFSET, 0);
     vbe_set_register(VBE_DISPI_INDEX_Y_OFFSET, 0);
     vbe_flip = 0;
-
-    vbe_refcnt = 1;
     return 0;
 }
 
@@ -0,0 +1,839 @@
+#include "vm.h"
+#include "types.h"
+#include "debug.h"
+#include "math.h"
+#include "string.h"
+#include "paging.h"
+#include "myalloc.h"
+#include "list.h"
+#include "filesys.h"
+#include "pagecache.h"
+#include "shm.h"
+
+/*
+ * Software-defined bit in the avail field of page table entries.
+ * Marks a read-only mapping of a frame that is shared with another
+ * address space, and must be copied on the first write.
+ */
+#define PTE_AVAIL_COW 0x1
+
+/*
+ * Software-defined bit in the avail field of page table entries.
+ * Marks a mapping of a filesystem data block, which is not owned
+ * by the frame allocator and must never be freed.
+ */
+#define PTE_AVAIL_DIRECT 0x2
+
+/*
+ * Software-defined bit in the avail field of page table entries.
+ * Marks a writable mapping of a shared memory frame, which must
+ * stay writable (and shared) when the address space is cloned.
+ */
+#define PTE_AVAIL_SHARED 0x4
+
+/* Number of page table entries in a single page table */
+#define VM_TABLE_SIZE (PAGE_SIZE / FRAME_SIZE)
+
+/*
+ * Helpful macros to access page table stuff. The table number
+ * is the index of the page table in vm_t.tables, and the table
+ * index is the index of the entry within that page table.
+ */
+#define TO_TABLE_NUM(addr) (((addr) - USER_PAGE_START) / PAGE_SIZE)
+#define TO_TABLE_INDEX(addr) (((addr) / FRAME_SIZE) % VM_TABLE_SIZE)
+#define TABLE_NUM_TO_ADDR(i) (USER_PAGE_START + (i) * PAGE_SIZE)
+#define PTE_TO_PADDR(pte) ((uintptr_t)(pte)->base_addr << 12)
+#define PADDR_TO_BASE(paddr) ((paddr) >> 12)
+
+/* The address space that is currently mapped in memory */
+static vm_t *vm_active = NULL;
+
+/*
+ * Returns a pointer to the page table entry for the specified
+ * address. If the page table does not exist yet, it will be
+ * allocated if alloc is true; otherwise, NULL is returned.
+ * Also returns NULL if the page table cannot be allocated.
+ */
+static pte_t *
+vm_get_pte(vm_t *vm, uintptr_t addr, bool alloc)
+{
+    int i = TO_TABLE_NUM(addr);
+    if (vm->tables[i] == 0) {
+        if (!alloc) {
+            return NULL;
+        }
+
+        uintptr_t paddr = paging_frame_alloc_zeroed();
+        if (paddr == 0) {
+            debugf("Cannot allocate page table\n");
+            return NULL;
+        }
+
+        vm->tables[i] = paddr;
+
+        /* Non-present entries are never cached, no need to flush */
+        if (vm == vm_active) {
+            paging_set_user_table(addr, paddr);
+        }
+    }
+
+    pte_t *table = paging_phys_to_virt(vm->tables[i]);
+    return &table[TO_TABLE_INDEX(addr)];
+}
+
+/*
+ * Unmaps all pages in the specified range and releases their
+ * frames. The range must be 4KB-aligned. Page tables are not
+ * freed.
+ */
+static void
+vm_unmap_range(vm_t *vm, uintptr_t start, uintptr_t end)
+{
+    assert(start % FRAME_SIZE == 0 && end % FRAME_SIZE == 0);
+
+    uintptr_t addr = start;
+    while (addr < end) {
+        pte_t *pte = vm_get_pte(vm, addr, false);
+
+        /* Skip the entire 4MB region if there's no page table */
+        if (pte == NULL) {
+            addr = next_multiple_of(addr, PAGE_SIZE);
+            continue;
+        }
+
+        if (pte->present) {
+            if (!(pte->avail & PTE_AVAIL_DIRECT)) {
+                paging_frame_free(PTE_TO_PADDR(pte));
+            }
+            memset(pte, 0, sizeof(pte_t));
+        }
+        addr += FRAME_SIZE;
+    }
+
+    if (vm == vm_active) {
+        paging_flush_tlb();
+    }
+}
+
+/*
+ * Creates a new, empty address space. Returns NULL if
+ * there is not enough memory.
+ */
+vm_t *
+vm_create(void)
+{
+    vm_t *vm = malloc(sizeof(vm_t));
+    if (vm == NULL) {
+        debugf("Cannot allocate address space\n");
+        return NULL;
+    }
+
+    memset(vm->tables, 0, sizeof(vm->tables));
+    vm->brk = USER_HEAP_START;
+    list_init(&vm->areas);
+    vm->refcnt = 1;
+    return vm;
+}
+
+/*
+ * Allocates a new file-backed region and adds it to the
+ * address space. The region is neither writable nor direct
+ * by default. inode_idx may be -1 for regions that are not
+ * backed by a file. Returns NULL if there is not enough memory,
+ * or if the file has too many references.
+ */
+static vm_area_t *
+vm_add_area(vm_t *vm, uintptr_t start, uintptr_t end, int inode_idx, int offset, int filesz)
+{
+    vm_area_t *area = malloc(sizeof(vm_area_t));
+    if (area == NULL) {
+        debugf("Cannot allocate file mapping\n");
+        return NULL;
+    }
+
+    area->inode_idx = -1;
+    if (inode_idx >= 0) {
+        area->inode_idx = fs_map_inode(inode_idx);
+        if (area->inode_idx < 0) {
+            free(area);
+            return NULL;
+        }
+    }
+
+    area->start = start;
+    area->end = end;
+    area->offset = offset;
+    area->filesz = filesz;
+    area->writable = false;
+    area->direct = false;
+    area->shm = NULL;
+    list_add_tail(&area->list, &vm->areas);
+    return area;
+}
+
+/*
+ * Frees a region, releasing the file or shared memory
+ * segment that backs it. Its pages must already be unmapped.
+ */
+static void
+vm_free_area(vm_area_t *area)
+{
+    list_del(&area->list);
+    if (area->shm != NULL) {
+        shm_unmap(area->shm);
+    } else if (area->inode_idx >= 0) {
+        fs_unmap_inode(area->inode_idx);
+    }
+    free(area);
+}
+
+/*
+ * Removes a region from the address space, unmapping its
+ * pages.
+ */
+static void
+vm_remove_area(vm_t *vm, vm_area_t *area)
+{
+    vm_unmap_range(vm, area->start, area->end);
+    vm_free_area(area);
+}
+
+/*
+ * Finds the region created by vm_mmap() that contains the
+ * specified address, or NULL if there is none.
+ */
+static vm_area_t *
+vm_find_direct_area(vm_t *vm, uintptr_t addr)
+{
+    list_t *pos;
+    list_for_each(pos, &vm->areas) {
+        vm_area_t *area = list_entry(pos, vm_area_t, list);
+        if (area->direct && addr >= area->start && addr < area->end) {
+            return area;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Finds the lowest free range of the specified size in the
+ * mmap region. Returns 0 if there is no space left.
+ */
+static uintptr_t
+vm_find_mmap_space(vm_t *vm, int size)
+{
+    uintptr_t start = USER_MMAP_START;
+    while (start <= USER_MMAP_END - size) {
+        bool overlaps = false;
+
+        list_t *pos;
+        list_for_each(pos, &vm->areas) {
+            vm_area_t *area = list_entry(pos, vm_area_t, list);
+            if (area->direct && area->start < start + size && start < area->end) {
+                start = area->end;
+                overlaps = true;
+                break;
+            }
+        }
+
+        if (!overlaps) {
+            return start;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Maps part of a file into the address space. The region
+ * [start, start + memsz) will be lazily filled with the
+ * first filesz bytes of the file starting at offset, with
+ * the remainder filled with zeros. The region must lie
+ * within the user page. The file cannot be modified until
+ * the address space is destroyed. Pages that are entirely
+ * covered by read-only mappings of the same file are shared
+ * with other address spaces mapping the file. Returns 0 on
+ * success, or -1 if there is not enough memory.
+ */
+int
+vm_map_file(vm_t *vm, uintptr_t start, int memsz, int inode_idx, int offset, int filesz, bool writable)
+{
+    assert(start >= USER_PAGE_START && start + memsz <= USER_PAGE_END);
+    assert(filesz >= 0 && filesz <= memsz);
+
+    vm_area_t *area = vm_add_area(vm, start, start + memsz, inode_idx, offset, filesz);
+    if (area == NULL) {
+        return -1;
+    }
+
+    area->writable = writable;
+    return 0;
+}
+
+/*
+ * Copies the file mappings from one address space to another.
+ * Returns -1 if there is not enough memory.
+ */
+static int
+vm_clone_areas(vm_t *dest, vm_t *src)
+{
+    list_t *pos;
+    list_for_each(pos, &src->areas) {
+        vm_area_t *area = list_entry(pos, vm_area_t, list);
+        vm_area_t *copy = vm_add_area(
+            dest,
+            area->start,
+            area->end,
+            area->inode_idx,
+            area->offset,
+            area->filesz);
+        if (copy == NULL) {
+            return -1;
+        }
+
+        copy->writable = area->writable;
+        copy->direct = area->direct;
+        if (area->shm != NULL) {
+            copy->shm = shm_map(area->shm);
+        }
+    }
+    return 0;
+}
+
+/*
+ * Clones an existing address space. Instead of copying the
+ * pages, both address spaces will share the same frames, which
+ * are made read-only and copied on the first write. Shared
+ * memory pages stay writable in both. Returns NULL if there
+ * is not enough memory.
+ */
+vm_t *
+vm_clone(vm_t *src)
+{
+    vm_t *dest = vm_create();
+    if (dest == NULL) {
+        return NULL;
+    }
+
+    dest->brk = src->brk;
+    if (vm_clone_areas(dest, src) < 0) {
+        vm_destroy(dest);
+        return NULL;
+    }
+
+    int i;
+    for (i = 0; i < VM_NUM_TABLES; ++i) {
+        if (src->tables[i] == 0) {
+            continue;
+        }
+
+        uintptr_t paddr = paging_frame_alloc();
+        if (paddr == 0) {
+            debugf("Cannot allocate page table for clone\n");
+            vm_destroy(dest);
+            dest = NULL;
+            break;
+        }
+
+        pte_t *src_table = paging_phys_to_virt(src->tables[i]);
+        pte_t *dest_table = paging_phys_to_virt(paddr);
+
+        int j;
+        for (j = 0; j < VM_TABLE_SIZE; ++j) {
+            pte_t *pte = &src_table[j];
+            if (pte->present) {
+                if (pte->write && !(pte->avail & PTE_AVAIL_SHARED)) {
+                    pte->write = 0;
+                    pte->avail |= PTE_AVAIL_COW;
+                }
+                if (!(pte->avail & PTE_AVAIL_DIRECT)) {
+                    paging_frame_retain(PTE_TO_PADDR(pte));
+                }
+            }
+            dest_table[j] = *pte;
+        }
+
+        dest->tables[i] = paddr;
+    }
+
+    /*
+     * Source pages may have been made read-only, flush even
+     * if the clone failed.
+     */
+    if (src == vm_active) {
+        paging_flush_tlb();
+    }
+
+    return dest;
+}
+
+/*
+ * Frees an address space, releasing all frames mapped in it.
+ * If the address space is currently active, it is unmapped
+ * first.
+ */
+void
+vm_destroy(vm_t *vm)
+{
+    if (vm == vm_active) {
+        vm_install(NULL);
+    }
+
+    vm_unmap_range(vm, USER_PAGE_START, USER_MMAP_END);
+
+    int i;
+    for (i = 0; i < VM_NUM_TABLES; ++i) {
+        if (vm->tables[i] != 0) {
+            paging_frame_free(vm->tables[i]);
+        }
+    }
+
+    list_t *pos, *next;
+    list_for_each_safe(pos, next, &vm->areas) {
+        vm_area_t *area = list_entry(pos, vm_area_t, list);
+        vm_free_area(area);
+    }
+
+    free(vm);
+}
+
+/*
+ * Increments the reference count of an address space.
+ * Returns the same address space for convenience.
+ */
+vm_t *
+vm_retain(vm_t *vm)
+{
+    assert(vm->refcnt > 0);
+    vm->refcnt++;
+    return vm;
+}
+
+/*
+ * Decrements the reference count of an address space,
+ * destroying it once the last process using it lets go.
+ */
+void
+vm_release(vm_t *vm)
+{
+    assert(vm->refcnt > 0);
+    if (--vm->refcnt == 0) {
+        vm_destroy(vm);
+    }
+}
+
+/*
+ * Maps the specified address space into memory, replacing
+ * the currently active one. vm may be NULL, in which case
+ * all user pages are unmapped. Returns the previously active
+ * address space.
+ */
+vm_t *
+vm_install(vm_t *vm)
+{
+    vm_t *prev = vm_active;
+    vm_active = vm;
+
+    int i;
+    for (i = 0; i < VM_NUM_TABLES; ++i) {
+        uintptr_t table = (vm != NULL) ? vm->tables[i] : 0;
+        paging_set_user_table(TABLE_NUM_TO_ADDR(i), table);
+    }
+
+    paging_flush_tlb();
+    return prev;
+}
+
+/*
+ * Allocates a direct region of the specified length in the
+ * mmap region of the address space. Returns NULL if the
+ * length is invalid or there is not enough space.
+ */
+static vm_area_t *
+vm_add_mmap_area(vm_t *vm, int length, int inode_idx, int offset, int filesz)
+{
+    assert(length > 0 && offset % FRAME_SIZE == 0);
+
+    int size = round_up(length, FRAME_SIZE);
+    if (size <= 0 || size > (int)(USER_MMAP_END - USER_MMAP_START)) {
+        debugf("Invalid mmap size: %d\n", length);
+        return NULL;
+    }
+
+    uintptr_t start = vm_find_mmap_space(vm, size);
+    if (start == 0) {
+        debugf("No space left for mmap\n");
+        return NULL;
+    }
+
+    vm_area_t *area = vm_add_area(vm, start, start + size, inode_idx, offset, filesz);
+    if (area == NULL) {
+        return NULL;
+    }
+
+    area->direct = true;
+    return area;
+}
+
+/*
+ * Maps length bytes of a file starting at offset into the
+ * mmap region of the address space, returning the address
+ * of the mapping, or 0 on error. Only the first filesz bytes
+ * come from the file; the rest are zero. Pages are mapped
+ * directly from the filesystem on first access, so no data is
+ * copied. If writable is true, the mapping is private, and
+ * pages are copied on the first write. Otherwise, writes to
+ * the mapping are not allowed.
+ */
+uintptr_t
+vm_mmap(vm_t *vm, int length, int inode_idx, int offset, int filesz, bool writable)
+{
+    assert(filesz >= 0 && filesz <= length);
+
+    vm_area_t *area = vm_add_mmap_area(vm, length, inode_idx, offset, filesz);
+    if (area == NULL) {
+        return 0;
+    }
+
+    area->writable = writable;
+    return area->start;
+}
+
+/*
+ * Maps length bytes of a shared memory segment starting at
+ * offset into the mmap region of the address space, returning
+ * the address of the mapping, or 0 on error. Writes to the
+ * mapping are visible to every address space that maps the
+ * segment, including clones of this one.
+ */
+uintptr_t
+vm_mmap_shm(vm_t *vm, int length, shm_t *shm, int offset)
+{
+    assert(offset + length <= round_up(shm->size, FRAME_SIZE));
+
+    vm_area_t *area = vm_add_mmap_area(vm, length, -1, offset, 0);
+    if (area == NULL) {
+        return 0;
+    }
+
+    area->writable = true;
+    area->shm = shm_map(shm);
+    return area->start;
+}
+
+/*
+ * Removes a mapping created by vm_mmap(). addr must be the
+ * address returned by vm_mmap(). Returns -1 if there is no
+ * such mapping.
+ */
+int
+vm_munmap(vm_t *vm, uintptr_t addr)
+{
+    vm_area_t *area = vm_find_direct_area(vm, addr);
+    if (area == NULL || area->start != addr) {
+        debugf("Invalid munmap address: 0x%08x\n", addr);
+        return -1;
+    }
+
+    vm_remove_area(vm, area);
+    return 0;
+}
+
+/*
+ * Grows or shrinks the heap, depending on the value of delta.
+ * Returns NULL on error (i.e. the heap would exceed its bounds).
+ * On success, returns the previous brk's virtual address. Pages
+ * are not allocated until they are first accessed.
+ */
+void *
+vm_sbrk(vm_t *vm, int delta)
+{
+    uintptr_t orig_brk = vm->brk;
+    int orig_size = orig_brk - USER_HEAP_START;
+
+    if (delta == 0) {
+        return (void *)orig_brk;
+    }
+
+    /* Upper bound limit (if delta is huge, rhs is negative -> true) */
+    int max_heap_size = USER_HEAP_END - USER_HEAP_START;
+    if (delta > 0 && orig_size > max_heap_size - delta) {
+        debugf("Trying to expand heap beyond size limit\n");
+        return NULL;
+    }
+
+    /* Lower bound limit */
+    if (delta < 0 && orig_size + delta < 0) {
+        debugf("Trying to deallocate more than was allocated\n");
+        return NULL;
+    }
+
+    /* Release pages that are no longer part of the heap */
+    vm->brk = orig_brk + delta;
+    if (delta < 0) {
+        vm_unmap_range(
+            vm,
+            round_up(vm->brk, FRAME_SIZE),
+            round_up(orig_brk, FRAME_SIZE));
+    }
+
+    return (void *)orig_brk;
+}
+
+/*
+ * Returns whether the specified address is part of
+ * the address space (i.e. it may be paged in on access).
+ */
+static bool
+vm_is_valid_addr(vm_t *vm, uintptr_t addr)
+{
+    if (addr >= USER_PAGE_START && addr < USER_PAGE_END) {
+        return true;
+    } else if (addr >= USER_HEAP_START && addr < round_up(vm->brk, FRAME_SIZE)) {
+        return true;
+    } else if (addr >= USER_MMAP_START && addr < USER_MMAP_END) {
+        return vm_find_direct_area(vm, addr) != NULL;
+    } else {
+        return false;
+    }
+}
+
+/*
+ * Fills a newly allocated zeroed frame with the contents of
+ * the page at the specified address, by reading the parts of
+ * the page that are backed by a file.
+ */
+static void
+vm_fill_page(vm_t *vm, uintptr_t page, uint8_t *frame)
+{
+    list_t *pos;
+    list_for_each(pos, &vm->areas) {
+        vm_area_t *area = list_entry(pos, vm_area_t, list);
+
+        /* Compute intersection of page and file data */
+        uintptr_t start = max(page, area->start);
+        uintptr_t end = min(page + FRAME_SIZE, area->start + area->filesz);
+        if (start >= end) {
+            continue;
+        }
+
+        /* Reading past EOF is checked on load, just leave zeros */
+        int offset = area->offset + (start - area->start);
+        fs_read_data(area->inode_idx, offset, frame + (start - page), end - start, memcpy);
+    }
+}
+
+/*
+ * Returns the inode backing the page at the specified address,
+ * if the page can be shared through the page cache. This is
+ * the case if the entire page is covered by read-only mappings
+ * of a single file. Otherwise, returns -1.
+ */
+static int
+vm_get_shared_inode(vm_t *vm, uintptr_t page)
+{
+    int inode_idx = -1;
+    int covered = 0;
+
+    list_t *pos;
+    list_for_each(pos, &vm->areas) {
+        vm_area_t *area = list_entry(pos, vm_area_t, list);
+        uintptr_t start = max(page, area->start);
+        uintptr_t end = min(page + FRAME_SIZE, area->end);
+        if (start >= end) {
+            continue;
+        }
+
+        if (area->writable || (inode_idx >= 0 && area->inode_idx != inode_idx)) {
+            return -1;
+        }
+
+        inode_idx = area->inode_idx;
+        covered += end - start;
+    }
+
+    return (covered == FRAME_SIZE) ? inode_idx : -1;
+}
+
+/*
+ * Allocates a frame for a user page, optionally filled with
+ * zeros. If memory is low, unused pages are evicted from the
+ * page cache.
+ */
+static uintptr_t
+vm_alloc_frame(bool zero)
+{
+    uintptr_t (*alloc)(void) = zero ? paging_frame_alloc_zeroed : paging_frame_alloc;
+    uintptr_t paddr = alloc();
+    if (paddr == 0 && pagecache_shrink() > 0) {
+        paddr = alloc();
+    }
+    return paddr;
+}
+
+/*
+ * Maps a page of a shared memory region. The segment's frame
+ * is mapped writable in place. Returns false if there is not
+ * enough memory.
+ */
+static bool
+vm_map_shm(vm_area_t *area, uintptr_t page, pte_t *pte)
+{
+    int index = (area->offset + (page - area->start)) / FRAME_SIZE;
+    uintptr_t paddr = shm_get_frame(area->shm, index);
+    if (paddr == 0) {
+        return false;
+    }
+
+    pte->present = 1;
+    pte->write = 1;
+    pte->user = 1;
+    pte->avail = PTE_AVAIL_SHARED;
+    pte->base_addr = PADDR_TO_BASE(paddr);
+    return true;
+}
+
+/*
+ * Maps a page of a region created by vm_mmap(). If the page
+ * is entirely backed by the file, the filesystem data block is
+ * mapped read-only (copy-on-write for private mappings).
+ * Otherwise, the page is copied into a new frame. Returns
+ * false if there is not enough memory.
+ */
+static bool
+vm_map_direct(vm_t *vm, vm_area_t *area, uintptr_t page, pte_t *pte)
+{
+    if (area->shm != NULL) {
+        return vm_map_shm(area, page, pte);
+    }
+
+    uintptr_t paddr = 0;
+    if ((int)(page - area->start) < area->filesz) {
+        int offset = area->offset + (page - area->start);
+        paddr = fs_inode_block_paddr(area->inode_idx, offset);
+    }
+
+    pte->present = 1;
+    pte->user = 1;
+    if (paddr != 0) {
+        pte->write = 0;
+        pte->avail = PTE_AVAIL_DIRECT;
+        if (area->writable) {
+            pte->avail |= PTE_AVAIL_COW;
+        }
+    } else {
+        paddr = vm_alloc_frame(true);
+        if (paddr == 0) {
+            debugf("Cannot allocate frame for mapped file\n");
+            pte->present = 0;
+            return false;
+        }
+
+        vm_fill_page(vm, page, paging_phys_to_virt(paddr));
+        pte->write = area->writable;
+        pte->avail = 0;
+    }
+    pte->base_addr = PADDR_TO_BASE(paddr);
+    return true;
+}
+
+/*
+ * Maps a new frame at the specified page table entry,
+ * filling it with the initial contents of the page at addr.
+ * Read-only file pages are taken from the page cache if
+ * possible. Returns false if there is not enough memory.
+ */
+static bool
+vm_map_new(vm_t *vm, uintptr_t addr, pte_t *pte)
+{
+    uintptr_t page = round_down(addr, FRAME_SIZE);
+    vm_area_t *direct = vm_find_direct_area(vm, page);
+    if (direct != NULL) {
+        return vm_map_direct(vm, direct, page, pte);
+    }
+
+    int inode_idx = vm_get_shared_inode(vm, page);
+
+    uintptr_t paddr = 0;
+    if (inode_idx >= 0) {
+        paddr = pagecache_get(inode_idx, page);
+    }
+
+    if (paddr == 0) {
+        paddr = vm_alloc_frame(true);
+        if (paddr == 0) {
+            debugf("Cannot allocate frame for user page\n");
+            return false;
+        }
+
+        vm_fill_page(vm, page, paging_phys_to_virt(paddr));
+        if (inode_idx >= 0) {
+            pagecache_add(inode_idx, page, paddr);
+        }
+    }
+
+    pte->present = 1;
+    pte->write = (inode_idx < 0);
+    pte->user = 1;
+    pte->avail = 0;
+    pte->base_addr = PADDR_TO_BASE(paddr);
+    return true;
+}
+
+/*
+ * Resolves a write to a copy-on-write page. If the frame is
+ * still shared (or is a filesystem block), its contents are
+ * copied to a new frame; otherwise, the page is simply made
+ * writable. Returns false if there is not enough memory.
+ */
+static bool
+vm_unshare(uintptr_t addr, pte_t *pte)
+{
+    uintptr_t paddr = PTE_TO_PADDR(pte);
+    bool direct = (pte->avail & PTE_AVAIL_DIRECT) != 0;
+    if (direct || paging_frame_is_shared(paddr)) {
+        uintptr_t new_paddr = vm_alloc_frame(false);
+        if (new_paddr == 0) {
+            debugf("Cannot allocate frame for copy-on-write\n");
+            return false;
+        }
+
+        memcpy(paging_phys_to_virt(new_paddr), paging_phys_to_virt(paddr), FRAME_SIZE);
+        if (!direct) {
+            paging_frame_free(paddr);
+        }
+        pte->base_addr = PADDR_TO_BASE(new_paddr);
+    }
+
+    pte->write = 1;
+    pte->avail &= ~(PTE_AVAIL_COW | PTE_AVAIL_DIRECT);
+    paging_invalidate_page(addr);
+    return true;
+}
+
+/*
+ * Attempts to resolve a page fault at the specified address in
+ * the active address space, by paging in a new page or copying
+ * a copy-on-write page. Returns true if the access can
+ * be retried, and false if the access is invalid.
+ */
+bool
+vm_handle_fault(uintptr_t addr, bool write)
+{
+    vm_t *vm = vm_active;
+    if (vm == NULL || !vm_is_valid_addr(vm, addr)) {
+        return false;
+    }
+
+    pte_t *pte = vm_get_pte(vm, addr, true);
+    if (pte == NULL) {
+        return false;
+    }
+
+    if (!pte->present) {
+        return vm_map_new(vm, addr, pte);
+    } else if (write && (pte->avail & PTE_AVAIL_COW)) {
+        return vm_unshare(addr, pte);
+    } else {
+        return false;
+    }
+}
@@ -0,0 +1,122 @@
+#ifndef _VM_H
+#define _VM_H
+
+#include "types.h"
+#include "list.h"
+#include "paging.h"
+
+/* Number of page tables needed to cover the user address space */
+#define VM_NUM_TABLES ((int)((USER_MMAP_END - USER_PAGE_START) / PAGE_SIZE))
+
+/* mmap() flags */
+#define MMAP_PRIVATE 1
+
+#ifndef ASM
+
+/* Forward declaration, see shm.h */
+struct shm;
+
+/*
+ * Region of the user address space that is backed by a file.
+ * Pages in the region are read in from the file when they are
+ * first accessed; anything beyond filesz is zero-filled. Regions
+ * created by mmap() instead map the file's data blocks directly.
+ */
+typedef struct {
+    /* Node in the vm_t areas list */
+    list_t list;
+
+    /* Virtual address range of the region */
+    uintptr_t start;
+    uintptr_t end;
+
+    /* Inode holding the contents of the region */
+    int inode_idx;
+
+    /* Offset in the file corresponding to start */
+    int offset;
+
+    /* Number of bytes from start that are read from the file */
+    int filesz;
+
+    /* Whether the region may be written to */
+    bool writable;
+
+    /*
+     * Whether pages are mapped directly from the filesystem
+     * instead of being copied. Writable direct regions are
+     * private, and pages are copied on the first write.
+     */
+    bool direct;
+
+    /*
+     * Shared memory segment backing the region, or NULL. If
+     * set, inode_idx is -1 and offset is relative to the start
+     * of the segment.
+     */
+    struct shm *shm;
+} vm_area_t;
+
+/*
+ * User address space. User memory is mapped with 4KB pages
+ * that are allocated on first access, so processes only use
+ * as much physical memory as they actually touch.
+ */
+typedef struct {
+    /*
+     * Physical addresses of the page tables for each 4MB
+     * region of the user address space, or 0 if no pages in
+     * that region have been mapped yet.
+     */
+    uintptr_t tables[VM_NUM_TABLES];
+
+    /* Current end of the heap (as modified by sbrk()) */
+    uintptr_t brk;
+
+    /* List of file-backed regions (vm_area_t) */
+    list_t areas;
+
+    /*
+     * Number of processes using this address space. Threads
+     * created by clone() share their creator's address space.
+     */
+    int refcnt;
+} vm_t;
+
+/* Creates a new empty address space */
+vm_t *vm_create(void);
+
+/* Creates a copy-on-write clone of an address space */
+vm_t *vm_clone(vm_t *src);
+
+/* Frees an address space and all pages mapped in it */
+void vm_destroy(vm_t *vm);
+
+/* Address space reference counting */
+vm_t *vm_retain(vm_t *vm);
+void vm_release(vm_t *vm);
+
+/* Makes the specified address space the active one */
+vm_t *vm_install(vm_t *vm);
+
+/* Maps part of a file into the address space */
+int vm_map_file(vm_t *vm, uintptr_t start, int memsz, int inode_idx, int offset, int filesz, bool writable);
+
+/* Maps a file into the mmap region of the address space */
+uintptr_t vm_mmap(vm_t *vm, int length, int inode_idx, int offset, int filesz, bool writable);
+
+/* Maps a shared memory segment into the mmap region */
+uintptr_t vm_mmap_shm(vm_t *vm, int length, struct shm *shm, int offset);
+
+/* Unmaps a region created by vm_mmap() */
+int vm_munmap(vm_t *vm, uintptr_t addr);
+
+/* Expands or shrinks the heap */
+void *vm_sbrk(vm_t *vm, int delta);
+
+/* Handles a page fault in the active address space */
+bool vm_handle_fault(uintptr_t addr, bool write);
+
+#endif /* ASM */
+
+#endif /* _VM_H */
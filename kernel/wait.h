@@ -29,11 +29,19 @@
  * interruptible is true and there are pending signals. If
  * nonblocking is true, this is the same as evaluating expr
  * directly.
+ *
+ * If excl is true, the caller is only woken by
+ * wait_queue_wake_one() if it is first in line. An exclusive
+ * waiter that slept but then gives up with an error may have
+ * been handed a wakeup meant for someone else, so it passes
+ * the wakeup on to the next waiter.
  */
-#define WAIT_IMPL(expr, queue, nonblocking, interruptible) ({             \
+#define WAIT_IMPL(expr, queue, nonblocking, interruptible, excl) ({       \
     int __ret;                                                            \
+    bool __slept = false;                                                 \
     wait_node_t __wait;                                                   \
     wait_node_init(&__wait, get_executing_pcb());                         \
+    __wait.exclusive = (excl);                                            \
     if ((queue) != NULL) {                                                \
         WAIT_IMPL_wait_queue_add(&__wait, (queue));                       \
     }                                                                     \
@@ -47,9 +55,13 @@
             break;                                                        \
         }                                                                 \
         scheduler_sleep();                                                \
+        __slept = true;                                                   \
     }                                                                     \
     if ((queue) != NULL) {                                                \
         wait_queue_remove(&__wait);                                       \
+        if (__wait.exclusive && __slept && __ret < 0) {                   \
+            wait_queue_wake_one(queue);                                   \
+        }                                                                 \
     }                                                                     \
     __ret;                                                                \
 })
@@ -60,7 +72,18 @@
  * there are pending signals.
  */
 #define WAIT_INTERRUPTIBLE(expr, queue, nonblocking) \
-    WAIT_IMPL(expr, queue, nonblocking, true)
+    WAIT_IMPL(expr, queue, nonblocking, true, false)
+
+/*
+ * Same as WAIT_INTERRUPTIBLE, but waits as an exclusive waiter.
+ * Use this when only one waiter can make progress per event
+ * (e.g. the event is consumed), so that waking every waiter
+ * would only send the rest straight back to sleep. Callers that
+ * leave the resource available for others after consuming
+ * their share must pass the wakeup on with wait_queue_wake_one().
+ */
+#define WAIT_INTERRUPTIBLE_EXCLUSIVE(expr, queue, nonblocking) \
+    WAIT_IMPL(expr, queue, nonblocking, true, true)
 
 /*
  * Evaluates expr in a loop, waiting for it to return a value
@@ -68,15 +91,17 @@
  * even if there are pending signals.
  */
 #define WAIT_UNINTERRUPTIBLE(expr, queue, nonblocking) \
-    WAIT_IMPL(expr, queue, nonblocking, false)
+    WAIT_IMPL(expr, queue, nonblocking, false, false)
 
 /*
  * Wait queue node. Contains a pointer to the process to be
- * woken up when the queue is notified.
+ * woken up when the queue is notified. Exclusive nodes are
+ * kept after all non-exclusive ones, in FIFO order.
  */
 typedef struct wait_node {
     list_t list;
     pcb_t *pcb;
+    bool exclusive;
 } wait_node_t;
 
 /*
@@ -87,6 +112,7 @@ wait_node_init(wait_node_t *node, pcb_t *pcb)
 {
     list_init(&node->list);
     node->pcb = pcb;
+    node->exclusive = false;
 }
 
 /*
@@ -100,13 +126,18 @@ wait_node_in_queue(wait_node_t *node)
 
 /*
  * Adds a node to the specified wait queue. The node must
- * not already be in a wait queue.
+ * not already be in a wait queue. Non-exclusive nodes go
+ * to the front, and exclusive nodes to the back.
  */
 static inline void
 wait_queue_add(wait_node_t *node, list_t *queue)
 {
     assert(!wait_node_in_queue(node));
-    list_add(&node->list, queue);
+    if (node->exclusive) {
+        list_add_tail(&node->list, queue);
+    } else {
+        list_add(&node->list, queue);
+    }
 }
 
 /*
@@ -133,6 +164,24 @@ wait_queue_wake(list_t *queue)
     }
 }
 
+/*
+ * Wakes all non-exclusive nodes and the first exclusive node
+ * in the specified wait queue. This does NOT remove them from
+ * the queue.
+ */
+static inline void
+wait_queue_wake_one(list_t *queue)
+{
+    list_t *pos, *next;
+    list_for_each_safe(pos, next, queue) {
+        wait_node_t *node = list_entry(pos, wait_node_t, list);
+        scheduler_wake(node->pcb);
+        if (node->exclusive) {
+            break;
+        }
+    }
+}
+
 #endif /* ASM */
 
 #endif /* _WAIT_H */
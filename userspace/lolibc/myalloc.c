@@ -3,8 +3,13 @@
  *
  * This allocator aims to follow in the spirit of the glibc implementation,
  * but with simplicity as the main design goal, instead of efficiency or
- * scalability. It uses a single free list instead of grouping blocks
- * into buckets, and is not at all thread safe.
+ * scalability. Small allocations are carved out of per-size-class slabs,
+ * so they never touch the free lists. Other free blocks are grouped into
+ * bins by size: small blocks get one bin per exact size, larger blocks
+ * get one bin per power of 2. Free memory at the top of the heap is
+ * returned to the kernel once it grows large enough. Calls are
+ * serialized by a single mutex, which makes it thread safe but not
+ * at all scalable.
  *
  * Some assumptions made:
  * - 2's complement, little endian, 8 bits per byte
@@ -21,6 +26,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <syscall.h>
+#include <thread.h>
 
 /*
  * Whether to poison new allocations with an invalid pattern to
@@ -49,7 +55,34 @@
  * Generally, this should be set to the page size for
  * maximum performance.
  */
-#define MYA_SBRK_ALIGN (4 * 1024 * 1024)
+#define MYA_SBRK_ALIGN (64 * 1024)
+
+/*
+ * When the free block at the top of the heap grows to at
+ * least this size, all but MYA_SBRK_ALIGN bytes of it are
+ * returned to the kernel.
+ */
+#define MYA_TRIM_THRESHOLD (4 * MYA_SBRK_ALIGN)
+
+/*
+ * Free list bins. Blocks up to MYA_SMALL_MAX bytes are binned
+ * by exact size; larger blocks are binned by the position of
+ * their highest set bit. The last bin holds everything else.
+ */
+#define MYA_SMALL_MAX 512
+#define MYA_NUM_SMALL_BINS ((int)(MYA_SMALL_MAX / MYA_DATA_ALIGN))
+#define MYA_NUM_BINS (MYA_NUM_SMALL_BINS + 24)
+#define MYA_BIN_MAP_BITS 32
+#define MYA_BIN_MAP_SIZE ((MYA_NUM_BINS + MYA_BIN_MAP_BITS - 1) / MYA_BIN_MAP_BITS)
+
+/*
+ * Allocations up to MYA_SLAB_MAX bytes are served from slabs.
+ * Each slab is a single MYA_SLAB_SIZE byte block holding objects
+ * of one size class.
+ */
+#define MYA_SLAB_MAX 256
+#define MYA_SLAB_SIZE 8192
+#define MYA_NUM_SLAB_CLASSES ((int)(sizeof(mya_slab_sizes) / sizeof(mya_slab_sizes[0])))
 
 /*
  * Masks for extracting the size and flags out of the
@@ -58,6 +91,12 @@
 #define MYA_MASK_SIZE ~0x7
 #define MYA_FLAG_USED 0x1
 
+/*
+ * Set in the curr_info field of slab objects, in which case
+ * the rest of the field points to the slab holding the object.
+ */
+#define MYA_FLAG_SLAB 0x2
+
 /*
  * Rounds up to a multiple of the specified alignment.
  * This may overflow if x is very large.
@@ -78,6 +117,8 @@
 
 /*
  * Macros for accessing the header size and flags independently.
+ * Setting the size clears MYA_FLAG_SLAB, since new headers may be
+ * created on top of stale slab object headers.
  *
  * w = which info field to access, either 'prev' or 'curr'
  * h = pointer to header
@@ -86,9 +127,11 @@
 #define mya_info(w, h) (h->w##_info)
 #define mya_size(w, h) (mya_info(w, h) & MYA_MASK_SIZE)
 #define mya_used(w, h) (mya_info(w, h) & MYA_FLAG_USED)
-#define mya_set_size(w, h, v) (mya_info(w, h) = (mya_info(w, h) & ~MYA_MASK_SIZE) | (v))
+#define mya_set_size(w, h, v) (mya_info(w, h) = (mya_info(w, h) & MYA_FLAG_USED) | (v))
 #define mya_set_used(w, h, v) (mya_info(w, h) = (mya_info(w, h) & ~MYA_FLAG_USED) | (v))
 #define mya_is_sentinel(w, h) (mya_size(w, h) == 0)
+#define mya_is_slab(h) (mya_info(curr, h) & MYA_FLAG_SLAB)
+#define mya_slab_of(h) ((mya_slab_t *)(mya_info(curr, h) & MYA_MASK_SIZE))
 
 /*
  * Macros for moving to the previous and next adjacent block headers.
@@ -144,10 +187,46 @@ typedef struct mya_header {
 } mya_header_t;
 
 /*
- * Doubly linked list of free blocks. If there are no free blocks,
- * this will be NULL.
+ * Slab header, stored at the start of the slab's block. It is
+ * followed by the slab's objects, each of which is preceded by
+ * a header whose curr_info field points back to the slab.
+ */
+typedef struct mya_slab {
+    /* Links in the list of slabs with free objects */
+    struct mya_slab *prev;
+    struct mya_slab *next;
+
+    /* Size class of the objects in this slab */
+    int cls;
+
+    /* Number of allocated objects in this slab */
+    int inuse;
+
+    /* Singly linked list of free objects (user data pointers) */
+    void *free;
+} mya_slab_t;
+
+/*
+ * Object sizes of each slab size class.
+ */
+static const size_t mya_slab_sizes[] = {8, 16, 24, 32, 48, 64, 96, 128, 192, 256};
+
+/*
+ * Doubly linked lists of slabs that have at least one free
+ * object, one per size class. Full slabs are not in any list.
+ */
+static mya_slab_t *mya_slabs[MYA_NUM_SLAB_CLASSES];
+
+/*
+ * Doubly linked lists of free blocks, one per bin. If there are
+ * no free blocks in a bin, its list will be NULL.
  */
-static mya_header_t *mya_free_list = NULL;
+static mya_header_t *mya_bins[MYA_NUM_BINS];
+
+/*
+ * Bitmap of bins that have at least one free block.
+ */
+static uint32_t mya_bin_map[MYA_BIN_MAP_SIZE];
 
 /*
  * This caches the value of the last call to sbrk, so that we can
@@ -161,23 +240,73 @@ static void *mya_last_brk = NULL;
 static bool mya_initialized = false;
 
 /*
- * Adds a block to the free list. Upon entry,
+ * Protects all allocator state against concurrent access
+ * from threads.
+ */
+static mutex_t mya_lock = MUTEX_INIT;
+
+/*
+ * Returns the index of the bin that holds free blocks
+ * with the specified user data size.
+ */
+static int
+mya_bin_index(size_t size)
+{
+    if (size <= MYA_SMALL_MAX) {
+        return size / MYA_DATA_ALIGN - 1;
+    }
+
+    /* log2(MYA_SMALL_MAX) == 9, so 513 goes in the first large bin */
+    int bin = MYA_NUM_SMALL_BINS;
+    size >>= 10;
+    while (size != 0 && bin < MYA_NUM_BINS - 1) {
+        size >>= 1;
+        bin++;
+    }
+    return bin;
+}
+
+/*
+ * Finds the first non-empty bin with an index of at least
+ * start. Returns MYA_NUM_BINS if there are none.
+ */
+static int
+mya_find_bin(int start)
+{
+    int bin;
+    for (bin = start; bin < MYA_NUM_BINS; ++bin) {
+        uint32_t word = mya_bin_map[bin / MYA_BIN_MAP_BITS] >> (bin % MYA_BIN_MAP_BITS);
+        if (word == 0) {
+            /* Skip to the start of the next word */
+            bin |= MYA_BIN_MAP_BITS - 1;
+        } else if (word & 1) {
+            return bin;
+        }
+    }
+    return MYA_NUM_BINS;
+}
+
+/*
+ * Adds a block to the free list of its bin. Upon entry,
  * prev_free and next_free may be in an invalid state.
  */
 static void
 mya_add_free_list(mya_header_t *header)
 {
+    int bin = mya_bin_index(mya_size(curr, header));
     header->prev_free = NULL;
-    header->next_free = mya_free_list;
-    if (mya_free_list != NULL) {
-        mya_free_list->prev_free = header;
+    header->next_free = mya_bins[bin];
+    if (mya_bins[bin] != NULL) {
+        mya_bins[bin]->prev_free = header;
     }
-    mya_free_list = header;
+    mya_bins[bin] = header;
+    mya_bin_map[bin / MYA_BIN_MAP_BITS] |= 1U << (bin % MYA_BIN_MAP_BITS);
 }
 
 /*
- * Removes a block from the free list. Upon exit,
- * prev_free and next_free may be in an invalid state.
+ * Removes a block from the free list of its bin. Upon exit,
+ * prev_free and next_free may be in an invalid state. The block
+ * size must not have changed since it was added.
  */
 static void
 mya_remove_free_list(mya_header_t *header)
@@ -185,8 +314,12 @@ mya_remove_free_list(mya_header_t *header)
     mya_header_t *prev_free = header->prev_free;
     mya_header_t *next_free = header->next_free;
 
-    if (mya_free_list == header) {
-        mya_free_list = next_free;
+    int bin = mya_bin_index(mya_size(curr, header));
+    if (mya_bins[bin] == header) {
+        mya_bins[bin] = next_free;
+        if (next_free == NULL) {
+            mya_bin_map[bin / MYA_BIN_MAP_BITS] &= ~(1U << (bin % MYA_BIN_MAP_BITS));
+        }
     }
 
     if (prev_free != NULL) {
@@ -215,6 +348,12 @@ mya_coalesce_next(mya_header_t *header)
     /* Remove next adjacent block from free list */
     mya_remove_free_list(next_adj);
 
+    /* Free blocks are binned by size, so re-bin this one too */
+    bool is_free = !mya_used(curr, header);
+    if (is_free) {
+        mya_remove_free_list(header);
+    }
+
     /* New size equals combined size of two blocks plus header overhead */
     size_t new_size = mya_size(curr, header) + MYA_INFO_SIZE + mya_size(curr, next_adj);
 
@@ -226,6 +365,10 @@ mya_coalesce_next(mya_header_t *header)
     /* Update size of the current block */
     mya_set_size(curr, header, new_size);
 
+    if (is_free) {
+        mya_add_free_list(header);
+    }
+
     return true;
 }
 
@@ -261,9 +404,8 @@ mya_coalesce(mya_header_t *header)
 }
 
 /*
- * Wrapper for sbrk that checks for overflow.
- * Note that delta is unsigned, since we don't support
- * shrinking the data break on free yet.
+ * Wrapper for sbrk that checks for overflow. Note that
+ * delta is unsigned; the heap is only shrunk by mya_trim().
  */
 static bool
 mya_sbrk(size_t delta, void **orig_brk, void **new_brk)
@@ -348,12 +490,15 @@ mya_initialize(void)
 /*
  * Finds a block that is large enough to fit an allocation
  * with the specified user data size, or NULL if there are
- * no available blocks that are large enough.
+ * no available blocks that are large enough. Only the bin
+ * that the size falls into needs to be searched for a best
+ * fit; every block in a higher bin is large enough.
  */
 static mya_header_t *
 mya_find_free_block(size_t aligned_size)
 {
-    mya_header_t *header = mya_free_list;
+    int bin = mya_bin_index(aligned_size);
+    mya_header_t *header = mya_bins[bin];
     mya_header_t *best = NULL;
     while (header != NULL) {
         if (mya_size(curr, header) >= aligned_size) {
@@ -363,6 +508,14 @@ mya_find_free_block(size_t aligned_size)
         }
         header = header->next_free;
     }
+
+    if (best == NULL) {
+        bin = mya_find_bin(bin + 1);
+        if (bin < MYA_NUM_BINS) {
+            best = mya_bins[bin];
+        }
+    }
+
     return best;
 }
 
@@ -406,8 +559,9 @@ mya_sbrk_new_block(size_t aligned_size)
 }
 
 /*
- * Attempts to split a block into two smaller blocks, with the first
- * having size >= aligned_size. If the block is too small, returns NULL.
+ * Attempts to split an allocated block into two smaller blocks, with
+ * the first having size >= aligned_size. If the block is too small,
+ * returns NULL.
  * Otherwise, returns a pointer to the second block, which will be unused.
  * The second block may be coalesced with the next adjacent block.
  */
@@ -468,29 +622,47 @@ mya_poison(void *ptr, size_t size, unsigned int pattern)
 }
 
 /*
- * Allocates the specified number of bytes and returns a pointer
- * to the allocated memory. If size equals 0 or there is no
- * more memory available, NULL is returned.
+ * Returns memory at the top of the heap to the kernel if the
+ * specified free block is the last block and is large enough.
+ * Some memory is kept around so that we don't immediately
+ * need to sbrk it back.
  */
-void *
-malloc(size_t size)
+static void
+mya_trim(mya_header_t *header)
 {
-    /* malloc(0) always returns NULL */
-    if (size == 0) {
-        return NULL;
+    size_t size = mya_size(curr, header);
+    if (size < MYA_TRIM_THRESHOLD || !mya_is_sentinel(curr, mya_next(header))) {
+        return;
     }
 
-    /* Initialize global state on first run */
-    if (!mya_initialized && !mya_initialize()) {
-        return NULL;
+    /* Keep at least MYA_SBRK_ALIGN bytes, release the rest in whole units */
+    size_t release = (size - MYA_SBRK_ALIGN) & -MYA_SBRK_ALIGN;
+    if (release == 0 || sbrk(-(int)release, NULL) < 0) {
+        return;
     }
 
-    /* Round allocation size up to an appropriate alignment */
-    size_t aligned_size = mya_round_up(size, MYA_DATA_ALIGN);
-    if (aligned_size == 0) {
-        return NULL;
-    }
+    mya_remove_free_list(header);
+    mya_last_brk = mya_as_bytes(mya_last_brk) - release;
+
+    /* Shrink the block and move the sentinel down */
+    mya_set_size(curr, header, size - release);
+    mya_header_t *sentinel = mya_next(header);
+    mya_set_size(prev, sentinel, size - release);
+    mya_set_used(prev, sentinel, 0);
+    mya_set_size(curr, sentinel, 0);
+    mya_set_used(curr, sentinel, 1);
 
+    mya_add_free_list(header);
+}
+
+/*
+ * Allocates a block with the specified aligned user data
+ * size from the free lists, extending the heap if necessary.
+ * Returns NULL if there is no more memory available.
+ */
+static void *
+mya_alloc_block(size_t aligned_size)
+{
     /*
      * First try to find an existing free block.
      * If that fails, try to allocate a new block.
@@ -504,9 +676,6 @@ malloc(size_t size)
         }
     }
 
-    /* Split the block as necessary */
-    mya_split_block(header, aligned_size);
-
     /* Remove block from the free list */
     mya_remove_free_list(header);
 
@@ -514,18 +683,209 @@ malloc(size_t size)
     mya_set_used(curr, header, 1);
     mya_set_used(prev, mya_next(header), 1);
 
-    /* Return pointer to the user data */
-    void *ptr = mya_header_to_data(header);
-    mya_poison(ptr, aligned_size, MYA_POISON_UNINIT);
+    /* Split the block as necessary */
+    mya_split_block(header, aligned_size);
+
+    return mya_header_to_data(header);
+}
+
+/*
+ * Returns a block obtained from mya_alloc_block() to the
+ * free lists.
+ */
+static void
+mya_free_block(mya_header_t *header)
+{
+    /* Mark block as free */
+    mya_set_used(curr, header, 0);
+    mya_set_used(prev, mya_next(header), 0);
+
+    /* Add block into the free list */
+    mya_add_free_list(header);
+
+    /* Coalesce with any neighboring free blocks */
+    header = mya_coalesce(header);
+
+    /* Give memory back to the kernel if we have too much */
+    mya_trim(header);
+}
+
+/*
+ * Returns the slab size class for an allocation with the
+ * specified aligned size, or -1 if it is too large for slabs.
+ */
+static int
+mya_slab_class(size_t aligned_size)
+{
+    int cls;
+    for (cls = 0; cls < MYA_NUM_SLAB_CLASSES; ++cls) {
+        if (aligned_size <= mya_slab_sizes[cls]) {
+            return cls;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Adds a slab to the list of slabs with free objects.
+ */
+static void
+mya_slab_link(mya_slab_t *slab)
+{
+    slab->prev = NULL;
+    slab->next = mya_slabs[slab->cls];
+    if (slab->next != NULL) {
+        slab->next->prev = slab;
+    }
+    mya_slabs[slab->cls] = slab;
+}
+
+/*
+ * Removes a slab from the list of slabs with free objects.
+ */
+static void
+mya_slab_unlink(mya_slab_t *slab)
+{
+    if (mya_slabs[slab->cls] == slab) {
+        mya_slabs[slab->cls] = slab->next;
+    }
+    if (slab->prev != NULL) {
+        slab->prev->next = slab->next;
+    }
+    if (slab->next != NULL) {
+        slab->next->prev = slab->prev;
+    }
+}
+
+/*
+ * Allocates a new slab for the specified size class and
+ * adds it to the slab list. Returns NULL if there is no more
+ * memory available.
+ */
+static mya_slab_t *
+mya_slab_new(int cls)
+{
+    mya_slab_t *slab = mya_alloc_block(MYA_SLAB_SIZE);
+    if (slab == NULL) {
+        return NULL;
+    }
+
+    slab->cls = cls;
+    slab->inuse = 0;
+    slab->free = NULL;
+
+    /* Objects follow the slab header, each with its own header */
+    size_t stride = MYA_INFO_SIZE + mya_slab_sizes[cls];
+    char *start = mya_as_bytes(slab) + mya_round_up(sizeof(mya_slab_t), MYA_DATA_ALIGN);
+    char *end = mya_as_bytes(slab) + MYA_SLAB_SIZE;
+    char *obj;
+    for (obj = start; obj + stride <= end; obj += stride) {
+        mya_header_t *header = mya_as_header(obj);
+        mya_info(curr, header) = (size_t)slab | MYA_FLAG_SLAB | MYA_FLAG_USED;
+
+        void **data = (void **)mya_header_to_data(header);
+        *data = slab->free;
+        slab->free = data;
+    }
+
+    mya_slab_link(slab);
+    return slab;
+}
+
+/*
+ * Allocates an object from a slab of the specified size class.
+ * Returns NULL if there is no more memory available.
+ */
+static void *
+mya_slab_alloc(int cls)
+{
+    mya_slab_t *slab = mya_slabs[cls];
+    if (slab == NULL) {
+        slab = mya_slab_new(cls);
+        if (slab == NULL) {
+            return NULL;
+        }
+    }
+
+    void **data = slab->free;
+    slab->free = *data;
+    slab->inuse++;
+
+    /* Full slabs don't need to be in the list */
+    if (slab->free == NULL) {
+        mya_slab_unlink(slab);
+    }
+
+    return data;
+}
+
+/*
+ * Returns an object to its slab. If the slab becomes empty
+ * and there are other slabs with free objects in the same
+ * size class, the slab is freed.
+ */
+static void
+mya_slab_free(mya_slab_t *slab, void *ptr)
+{
+    bool was_full = (slab->free == NULL);
+
+    void **data = ptr;
+    *data = slab->free;
+    slab->free = data;
+    slab->inuse--;
+
+    if (was_full) {
+        mya_slab_link(slab);
+    }
+
+    if (slab->inuse == 0 && (slab->prev != NULL || slab->next != NULL)) {
+        mya_slab_unlink(slab);
+        mya_free_block(mya_data_to_header(slab));
+    }
+}
+
+/*
+ * malloc() implementation. Must be called with mya_lock held.
+ */
+static void *
+mya_malloc(size_t size)
+{
+    /* malloc(0) always returns NULL */
+    if (size == 0) {
+        return NULL;
+    }
+
+    /* Initialize global state on first run */
+    if (!mya_initialized && !mya_initialize()) {
+        return NULL;
+    }
+
+    /* Round allocation size up to an appropriate alignment */
+    size_t aligned_size = mya_round_up(size, MYA_DATA_ALIGN);
+    if (aligned_size == 0) {
+        return NULL;
+    }
+
+    /* Small allocations come from slabs */
+    void *ptr;
+    int cls = mya_slab_class(aligned_size);
+    if (cls >= 0) {
+        ptr = mya_slab_alloc(cls);
+    } else {
+        ptr = mya_alloc_block(aligned_size);
+    }
+
+    if (ptr != NULL) {
+        mya_poison(ptr, aligned_size, MYA_POISON_UNINIT);
+    }
     return ptr;
 }
 
 /*
- * Frees a block of memory originally allocated by malloc,
- * calloc, or realloc. Calling free on NULL is a no-op.
+ * free() implementation. Must be called with mya_lock held.
  */
-void
-free(void *ptr)
+static void
+mya_free(void *ptr)
 {
     /* free(NULL) is a no-op */
     if (ptr == NULL) {
@@ -535,18 +895,40 @@ free(void *ptr)
     /* Find header for the user data */
     mya_header_t *header = mya_data_to_header(ptr);
 
-    /* Poison original contents */
-    mya_poison(ptr, mya_size(curr, header), MYA_POISON_FREED);
-
-    /* Mark block as free */
-    mya_set_used(curr, header, 0);
-    mya_set_used(prev, mya_next(header), 0);
+    if (mya_is_slab(header)) {
+        mya_slab_t *slab = mya_slab_of(header);
+        mya_poison(ptr, mya_slab_sizes[slab->cls], MYA_POISON_FREED);
+        mya_slab_free(slab, ptr);
+    } else {
+        mya_poison(ptr, mya_size(curr, header), MYA_POISON_FREED);
+        mya_free_block(header);
+    }
+}
 
-    /* Add block into the free list */
-    mya_add_free_list(header);
+/*
+ * Allocates the specified number of bytes and returns a pointer
+ * to the allocated memory. If size equals 0 or there is no
+ * more memory available, NULL is returned.
+ */
+void *
+malloc(size_t size)
+{
+    mutex_lock(&mya_lock);
+    void *ptr = mya_malloc(size);
+    mutex_unlock(&mya_lock);
+    return ptr;
+}
 
-    /* Coalesce with any neighboring free blocks */
-    mya_coalesce(header);
+/*
+ * Frees a block of memory originally allocated by malloc,
+ * calloc, or realloc. Calling free on NULL is a no-op.
+ */
+void
+free(void *ptr)
+{
+    mutex_lock(&mya_lock);
+    mya_free(ptr);
+    mutex_unlock(&mya_lock);
 }
 
 /*
@@ -577,32 +959,49 @@ calloc(size_t num, size_t size)
 }
 
 /*
- * Changes the size of a previously allocated memory block.
- * The contents will be unchanged up to the previous size of
- * the block, and any additional memory will not be initialized.
- * If size equals 0, this is equivalent to calling free(ptr). If
- * ptr is NULL, this is equivalent to calling malloc(size).
+ * realloc() implementation. Must be called with mya_lock held.
  */
-void *
-realloc(void *ptr, size_t size)
+static void *
+mya_realloc(void *ptr, size_t size)
 {
     /* realloc(NULL, size) is the same as malloc(size) */
     if (ptr == NULL) {
-        return malloc(size);
+        return mya_malloc(size);
     }
 
     /* realloc(ptr, 0) is the same as free(ptr) */
     if (size == 0) {
-        free(ptr);
+        mya_free(ptr);
         return NULL;
     }
 
     /* Round allocation size up to an appropriate alignment */
     size_t aligned_size = mya_round_up(size, MYA_DATA_ALIGN);
+    if (aligned_size == 0) {
+        return NULL;
+    }
 
     /* Find header for the user data */
     mya_header_t *header = mya_data_to_header(ptr);
 
+    /*
+     * Slab objects can grow up to the size of their class.
+     * Otherwise, they need to be moved.
+     */
+    if (mya_is_slab(header)) {
+        size_t slab_size = mya_slab_sizes[mya_slab_of(header)->cls];
+        if (aligned_size <= slab_size) {
+            return ptr;
+        }
+
+        void *new_ptr = mya_malloc(size);
+        if (new_ptr != NULL) {
+            memcpy(new_ptr, ptr, slab_size);
+            mya_free(ptr);
+        }
+        return new_ptr;
+    }
+
     /* Save original size of block */
     size_t orig_size = mya_size(curr, header);
     char *orig_end = (char *)ptr + orig_size;
@@ -641,10 +1040,26 @@ realloc(void *ptr, size_t size)
      * We tried everything but we still can't resize it in-place,
      * fall back to malloc() followed by memcpy().
      */
-    void *new_ptr = malloc(size);
+    void *new_ptr = mya_malloc(size);
     if (new_ptr != NULL) {
         memcpy(new_ptr, ptr, orig_size);
-        free(ptr);
+        mya_free(ptr);
     }
     return new_ptr;
 }
+
+/*
+ * Changes the size of a previously allocated memory block.
+ * The contents will be unchanged up to the previous size of
+ * the block, and any additional memory will not be initialized.
+ * If size equals 0, this is equivalent to calling free(ptr). If
+ * ptr is NULL, this is equivalent to calling malloc(size).
+ */
+void *
+realloc(void *ptr, size_t size)
+{
+    mutex_lock(&mya_lock);
+    void *new_ptr = mya_realloc(ptr, size);
+    mutex_unlock(&mya_lock);
+    return new_ptr;
+}
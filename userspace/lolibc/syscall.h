@@ -48,7 +48,15 @@
 #define SYS_FBUNMAP     47
 #define SYS_FBFLIP      48
 #define SYS_POLL        49
-#define NUM_SYSCALL     49
+#define SYS_SPAWN       50
+#define SYS_MMAP        51
+#define SYS_MUNMAP      52
+#define SYS_SHMOPEN     53
+#define SYS_NICE        54
+#define SYS_RTPRIO      55
+#define SYS_CLONE       56
+#define SYS_FUTEX       57
+#define NUM_SYSCALL     57
 
 #ifndef ASM
 
@@ -59,6 +67,7 @@
 #define EINTR  2
 #define EAGAIN 3
 #define EPIPE  4
+#define ENOENT 5
 
 /* signal.h */
 #define SIGFPE 0
@@ -131,6 +140,30 @@ typedef struct {
     short revents;
 } pollfd_t;
 
+/* process.h */
+#define SPAWN_DUP 0
+#define SPAWN_CLOSE 1
+#define SPAWN_TCSETPGRP 2
+
+/* process.h */
+typedef struct {
+    int type;
+    int srcfd;
+    int destfd;
+} spawn_action_t;
+
+/* vm.h */
+#define MMAP_PRIVATE 1
+
+/* scheduler.h */
+#define NICE_MIN (-4)
+#define NICE_MAX 3
+#define RTPRIO_MAX 4
+
+/* futex.h */
+#define FUTEX_WAIT 0
+#define FUTEX_WAKE 1
+
 /* net.h */
 typedef struct {
     uint8_t bytes[4];
@@ -192,6 +225,14 @@ __cdecl int fbmap(void **ptr, int xres, int yres, int bpp);
 __cdecl int fbunmap(void *ptr);
 __cdecl int fbflip(void *ptr);
 __cdecl int poll(pollfd_t *pfd, int nfd, int timeout);
+__cdecl int spawn(const char *command, const spawn_action_t *actions, int nactions, int pgrp);
+__cdecl int mmap(void **ptr, int fd, int offset, int length, int flags);
+__cdecl int munmap(void *ptr);
+__cdecl int shmopen(const char *name, int size);
+__cdecl int nice(int inc);
+__cdecl int rtprio(int prio);
+__cdecl int clone(void *stack);
+__cdecl int futex(int *addr, int op, int val);
 
 #endif /* ASM */
 
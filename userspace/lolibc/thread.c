@@ -0,0 +1,208 @@
+#include <thread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+/*
+ * Atomically replaces *ptr with val, and returns the old
+ * value. xchg is used because it is the only atomic
+ * read-modify-write instruction available on the i386.
+ */
+static inline int
+atomic_xchg(volatile int *ptr, int val)
+{
+    asm volatile("xchgl %0, %1"
+                 : "+r"(val), "+m"(*ptr)
+                 :
+                 : "memory");
+    return val;
+}
+
+/*
+ * Atomically increments *ptr.
+ */
+static inline void
+atomic_inc(volatile int *ptr)
+{
+    asm volatile("lock; incl %0"
+                 : "+m"(*ptr)
+                 :
+                 : "memory");
+}
+
+/*
+ * Entry point of new threads. clone() returns into this
+ * function as if it had been called with thread as its
+ * argument (see thread_create()).
+ */
+static __cdecl __noreturn void
+thread_main(thread_t *thread)
+{
+    thread->ret = thread->fn(thread->arg);
+    halt(0);
+}
+
+/*
+ * Creates a thread that runs fn(arg) on a new stack of the
+ * specified size (or THREAD_STACK_SIZE if 0). The thread
+ * exits when fn returns. Returns 0 on success, or -1 if the
+ * stack could not be allocated or the thread could not be
+ * created.
+ */
+int
+thread_create(thread_t *thread, int (*fn)(void *), void *arg, size_t stack_size)
+{
+    if (stack_size == 0) {
+        stack_size = THREAD_STACK_SIZE;
+    }
+
+    thread->stack = malloc(stack_size);
+    if (thread->stack == NULL) {
+        return -1;
+    }
+
+    thread->fn = fn;
+    thread->arg = arg;
+    thread->ret = 0;
+
+    /*
+     * The new thread starts out inside the clone() syscall
+     * wrapper, which pops ebx, esi, and edi, then returns.
+     * Set up the stack so that it "returns" into thread_main
+     * with a fake return address and its argument above it.
+     */
+    uintptr_t top = ((uintptr_t)thread->stack + stack_size) & ~(uintptr_t)0xf;
+    uint32_t *sp = (uint32_t *)top - 6;
+    sp[0] = 0; /* edi */
+    sp[1] = 0; /* esi */
+    sp[2] = 0; /* ebx */
+    sp[3] = (uint32_t)thread_main;
+    sp[4] = 0; /* Return address of thread_main */
+    sp[5] = (uint32_t)thread;
+
+    thread->pid = clone(sp);
+    if (thread->pid < 0) {
+        free(thread->stack);
+        thread->stack = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Waits for a thread to exit, then frees its stack. If ret
+ * is not NULL, the return value of the thread function is
+ * copied to it. Must be called by the thread that created
+ * the thread. Returns 0 on success, or -1 if the thread was
+ * killed or the wait was interrupted by a signal.
+ */
+int
+thread_join(thread_t *thread, int *ret)
+{
+    int pid = thread->pid;
+    if (wait(&pid) != 0) {
+        return -1;
+    }
+
+    free(thread->stack);
+    thread->stack = NULL;
+    if (ret != NULL) {
+        *ret = thread->ret;
+    }
+    return 0;
+}
+
+/*
+ * Initializes a mutex to the unlocked state.
+ */
+void
+mutex_init(mutex_t *mutex)
+{
+    mutex->state = 0;
+}
+
+/*
+ * Sleeps until the mutex can be locked, marking it as
+ * contended so that the eventual unlocker wakes someone.
+ */
+static void
+mutex_lock_contended(mutex_t *mutex)
+{
+    while (atomic_xchg(&mutex->state, 2) != 0) {
+        futex((int *)&mutex->state, FUTEX_WAIT, 2);
+    }
+}
+
+/*
+ * Locks a mutex. Uncontended locks do not make any syscalls.
+ * Mutexes are not recursive.
+ */
+void
+mutex_lock(mutex_t *mutex)
+{
+    if (atomic_xchg(&mutex->state, 1) != 0) {
+        mutex_lock_contended(mutex);
+    }
+}
+
+/*
+ * Unlocks a mutex, waking one waiting thread if there
+ * might be any.
+ */
+void
+mutex_unlock(mutex_t *mutex)
+{
+    if (atomic_xchg(&mutex->state, 0) == 2) {
+        futex((int *)&mutex->state, FUTEX_WAKE, 1);
+    }
+}
+
+/*
+ * Initializes a condition variable.
+ */
+void
+cond_init(cond_t *cond)
+{
+    cond->seq = 0;
+}
+
+/*
+ * Atomically unlocks the mutex and waits for the condition
+ * variable to be signaled, then re-locks the mutex. As with
+ * any condition variable, wakeups may be spurious, so the
+ * caller must re-check its condition in a loop.
+ */
+void
+cond_wait(cond_t *cond, mutex_t *mutex)
+{
+    int seq = cond->seq;
+    mutex_unlock(mutex);
+    futex((int *)&cond->seq, FUTEX_WAIT, seq);
+
+    /*
+     * Other threads may have been woken along with us, so
+     * always treat the mutex as contended.
+     */
+    mutex_lock_contended(mutex);
+}
+
+/*
+ * Wakes one thread waiting on the condition variable.
+ */
+void
+cond_signal(cond_t *cond)
+{
+    atomic_inc(&cond->seq);
+    futex((int *)&cond->seq, FUTEX_WAKE, 1);
+}
+
+/*
+ * Wakes all threads waiting on the condition variable.
+ */
+void
+cond_broadcast(cond_t *cond)
+{
+    atomic_inc(&cond->seq);
+    futex((int *)&cond->seq, FUTEX_WAKE, INT_MAX);
+}
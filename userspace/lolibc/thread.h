@@ -0,0 +1,60 @@
+#ifndef _LOLIBC_THREAD_H
+#define _LOLIBC_THREAD_H
+
+#include <attrib.h>
+#include <stddef.h>
+
+/* Default stack size for new threads */
+#define THREAD_STACK_SIZE 16384
+
+/*
+ * Thread handle. Threads share the address space and open
+ * files of the process that created them, but have their
+ * own PID, so they must be joined by their creator.
+ */
+typedef struct {
+    int pid;
+    void *stack;
+    int (*fn)(void *arg);
+    void *arg;
+    int ret;
+} thread_t;
+
+/*
+ * Mutex built on futex(). state is 0 if unlocked, 1 if locked,
+ * and 2 if locked and there may be threads waiting for it.
+ */
+typedef struct {
+    volatile int state;
+} mutex_t;
+
+/*
+ * Condition variable built on futex(). seq is bumped on every
+ * signal, so that waiters can tell if they missed one.
+ */
+typedef struct {
+    volatile int seq;
+} cond_t;
+
+/* Static initializers */
+#define MUTEX_INIT {0}
+#define COND_INIT {0}
+
+/* Creates a thread that runs fn(arg) */
+int thread_create(thread_t *thread, int (*fn)(void *), void *arg, size_t stack_size);
+
+/* Waits for a thread to return and frees its stack */
+int thread_join(thread_t *thread, int *ret);
+
+/* Mutex functions */
+void mutex_init(mutex_t *mutex);
+void mutex_lock(mutex_t *mutex);
+void mutex_unlock(mutex_t *mutex);
+
+/* Condition variable functions */
+void cond_init(cond_t *cond);
+void cond_wait(cond_t *cond, mutex_t *mutex);
+void cond_signal(cond_t *cond);
+void cond_broadcast(cond_t *cond);
+
+#endif /* _LOLIBC_THREAD_H */
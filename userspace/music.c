@@ -252,6 +252,11 @@ main(void)
         goto cleanup;
     }
 
+    /* Run ahead of normal processes so the sound driver never runs dry */
+    if (rtprio(RTPRIO_MAX) < 0) {
+        fprintf(stderr, "Could not set real-time priority\n");
+    }
+
     /* Allocate buffer to hold the entire audio data (required for loop) */
     audio_data = malloc(data_size);
     if (audio_data == NULL) {
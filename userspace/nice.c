@@ -0,0 +1,36 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+
+int
+main(void)
+{
+    int ret = 1;
+
+    char args[128];
+    if (getargs(args, sizeof(args)) < 0) {
+        fprintf(stderr, "usage: nice <inc> <command>\n");
+        goto cleanup;
+    }
+
+    char *command = strchr(args, ' ');
+    if (command == NULL) {
+        fprintf(stderr, "usage: nice <inc> <command>\n");
+        goto cleanup;
+    }
+    *command++ = '\0';
+
+    int inc = atoi(args);
+    if (inc == 0 && strcmp(args, "0") != 0) {
+        fprintf(stderr, "Invalid increment: %s\n", args);
+        goto cleanup;
+    }
+
+    nice(inc);
+    exec(command);
+    fprintf(stderr, "%s: command not found\n", command);
+
+cleanup:
+    return ret;
+}
@@ -223,6 +223,29 @@ execute_command(cmd_t *cmd)
             FAIL("Cannot redirect stdout in middle of pipe\n");
         }
 
+        /*
+         * Open redirected streams. If non-negative, curr_rd
+         * either points to a file or the read end of a pipe,
+         * and curr_wr either points to a file or the write end
+         * of a pipe.
+         */
+        if (cmd->in != NULL) {
+            assert(curr_rd < 0);
+            curr_rd = create(cmd->in, OPEN_READ);
+            if (curr_rd < 0) {
+                FAIL("Failed to open '%s' for reading\n", cmd->in);
+            }
+        }
+
+        if (cmd->out != NULL) {
+            int mode = OPEN_WRITE | OPEN_CREATE;
+            mode |= cmd->out_append ? OPEN_APPEND : OPEN_TRUNC;
+            curr_wr = create(cmd->out, mode);
+            if (curr_wr < 0) {
+                FAIL("Failed to open '%s' for writing\n", cmd->out);
+            }
+        }
+
         /* Create a pipe for the next process in line */
         if (cmd->next != NULL) {
             if (pipe(&next_rd, &curr_wr) < 0) {
@@ -230,102 +253,71 @@ execute_command(cmd_t *cmd)
             }
         }
 
-        /* Okay, now let's fork! */
-        int pid = fork();
-        if (pid < 0) {
-            FAIL("Reached max number of processes\n");
-        } else if (pid == 0) {
-            /*
-             * We're in the child! Close the read endpoint of the pipe;
-             * that's for the next process in the pipeline to care about.
-             */
-            if (next_rd >= 0) {
-                close(next_rd);
-            }
-
-            /* Set process group and grab terminal foreground */
-            setpgrp(0, group_id);
-            tcsetpgrp(group_id);
-
-            /*
-             * Handle redirected streams. We do this in the child instead
-             * of the parent so we don't have to deal with closing the files
-             * used by other child processes in each child.
-             */
-            if (cmd->in != NULL) {
-                assert(curr_rd < 0);
-                curr_rd = create(cmd->in, OPEN_READ);
-                if (curr_rd < 0) {
-                    fprintf(stderr, "Failed to open '%s' for reading\n", cmd->in);
-                    halt(127);
-                }
-            }
+        /*
+         * Replace the child's stdin and stdout with the redirected
+         * streams. The read endpoint of the next pipe is for the
+         * next process in the pipeline to care about, so the child
+         * doesn't get it.
+         */
+        spawn_action_t actions[6];
+        int nactions = 0;
+        if (curr_rd >= 0) {
+            actions[nactions++] = (spawn_action_t){SPAWN_DUP, curr_rd, STDIN_FILENO};
+            actions[nactions++] = (spawn_action_t){SPAWN_CLOSE, curr_rd, -1};
+        }
+        if (curr_wr >= 0) {
+            actions[nactions++] = (spawn_action_t){SPAWN_DUP, curr_wr, STDOUT_FILENO};
+            actions[nactions++] = (spawn_action_t){SPAWN_CLOSE, curr_wr, -1};
+        }
+        if (next_rd >= 0) {
+            actions[nactions++] = (spawn_action_t){SPAWN_CLOSE, next_rd, -1};
+        }
 
-            /*
-             * If non-negative, curr_rd either points to a file or the read
-             * end of a pipe. Replace our stdin stream with it.
-             */
-            if (curr_rd >= 0) {
-                dup(curr_rd, STDIN_FILENO);
-                close(curr_rd);
-            }
+        /*
+         * The root process of the pipeline grabs the terminal
+         * foreground, before it gets a chance to produce any
+         * output that would otherwise be rejected.
+         */
+        if (group_id == 0) {
+            actions[nactions++] = (spawn_action_t){SPAWN_TCSETPGRP, -1, -1};
+        }
 
-            /* Do the same, this time for stdout */
-            if (cmd->out != NULL) {
-                assert(curr_wr < 0);
-                int mode = OPEN_WRITE | OPEN_CREATE;
-                mode |= cmd->out_append ? OPEN_APPEND : OPEN_TRUNC;
-                curr_wr = create(cmd->out, mode);
-                if (curr_wr < 0) {
-                    fprintf(stderr, "Failed to open '%s' for writing\n", cmd->out);
-                    halt(127);
-                }
-            }
-            if (curr_wr >= 0) {
-                dup(curr_wr, STDOUT_FILENO);
-                close(curr_wr);
-            }
+        /*
+         * Okay, now let's spawn! The child is placed in the
+         * group before it runs, using the PID of the root
+         * process as the group ID.
+         */
+        int pid = spawn(cmd->name, actions, nactions, group_id);
+        if (pid == -ENOENT) {
+            curr->exit_code = 127;
+            FAIL("%s: command not found\n", cmd->name);
+        } else if (pid == -EAGAIN) {
+            FAIL("Reached max number of processes\n");
+        } else if (pid < 0) {
+            FAIL("Failed to spawn '%s'\n", cmd->name);
+        }
 
-            /* And finally, execute the command! */
-            exec(cmd->name);
-            fprintf(stderr, "%s: command not found\n", cmd->name);
-            halt(127);
-        } else {
-            /*
-             * We're still in the parent (shell)! Save the PID of
-             * the child process.
-             */
-            curr->pid = pid;
-
-            /* Use the PID of the root process as the group ID */
-            if (group_id == 0) {
-                group_id = pid;
-            }
+        curr->pid = pid;
+        if (group_id == 0) {
+            group_id = pid;
+        }
 
-            /*
-             * Set group on behalf of child to handle the
-             * race condition where the parent first waits
-             * on the group before the child has executed yet.
-             */
-            setpgrp(pid, group_id);
-
-            /*
-             * Close the pipe read end from the current iteration (that
-             * was created in the previous iteration), and set the input
-             * stream for the next iteration to the read end of the
-             * pipe that was created in the current iteration.
-             */
-            if (curr_rd >= 0) {
-                close(curr_rd);
-            }
-            curr_rd = next_rd;
-            next_rd = -1;
+        /*
+         * Close the pipe read end from the current iteration (that
+         * was created in the previous iteration), and set the input
+         * stream for the next iteration to the read end of the
+         * pipe that was created in the current iteration.
+         */
+        if (curr_rd >= 0) {
+            close(curr_rd);
+        }
+        curr_rd = next_rd;
+        next_rd = -1;
 
-            /* Close the pipe write end from the current iteration */
-            if (curr_wr >= 0) {
-                close(curr_wr);
-                curr_wr = -1;
-            }
+        /* Close the pipe write end from the current iteration */
+        if (curr_wr >= 0) {
+            close(curr_wr);
+            curr_wr = -1;
         }
     }
 
@@ -366,7 +358,7 @@ cleanup:
     int exit_code = 255;
     while (root != NULL) {
         proc_t *next = root->next;
-        if (root->pid >= 0) {
+        if (root->pid >= 0 || root->exit_code == 127) {
             exit_code = root->exit_code;
             if (exit_code != 0 && exit_code != 127 && exit_code != 128 + SIGPIPE) {
                 fprintf(stderr, "%s finished with exit code %d\n", root->cmd->name, exit_code);
@@ -5,6 +5,9 @@
 
 #define MAX_FILES 8
 
+/* Stack for threads created by clone(), see fuzz() */
+static uint32_t clone_stack[64];
+
 static uint32_t
 globalrand(int fd)
 {
@@ -73,6 +76,26 @@ fuzz(int fd)
             continue;
         }
 
+        /*
+         * Give threads a valid stack. They would share our stack
+         * frame if they returned to C code, so they halt right
+         * away instead, without touching the stack.
+         */
+        if (eax == SYS_CLONE) {
+            ebx = (uint32_t)&clone_stack[64];
+            asm volatile(
+                "int $0x80;"
+                "testl %%eax, %%eax;"
+                "jnz 1f;"
+                "movl %1, %%eax;"
+                "int $0x80;"
+                "1:"
+                : "+a"(eax)
+                : "i"(SYS_HALT), "b"(ebx), "c"(ecx), "d"(edx), "S"(esi), "D"(edi)
+                : "memory", "cc");
+            continue;
+        }
+
         asm volatile(
             "int $0x80;"
             :
@@ -223,6 +223,106 @@ test_write_large_file(void)
     close(fd);
 }
 
+static void
+test_mmap(void)
+{
+    int fd = mktemp(0);
+    int ret;
+    char buf[4096];
+    char *p;
+
+    memset(buf, 'a', sizeof(buf));
+    ret = write(fd, buf, sizeof(buf));
+    assert(ret == sizeof(buf));
+    ret = write(fd, "bc", 2);
+    assert(ret == 2);
+
+    ret = mmap((void **)&p, fd, 0, 4098, 0);
+    assert(ret == 0);
+    assert(p[0] == 'a');
+    assert(p[4095] == 'a');
+    assert(p[4096] == 'b');
+    assert(p[4097] == 'c');
+    assert(p[4098] == '\0');
+
+    /* File can't be modified while mapped */
+    ret = write(fd, "d", 1);
+    assert(ret < 0);
+
+    ret = munmap(p);
+    assert(ret == 0);
+
+    ret = write(fd, "d", 1);
+    assert(ret == 1);
+
+    close(fd);
+}
+
+static void
+test_mmap_private(void)
+{
+    int fd = mktemp(0);
+    int ret;
+    char buf[4096];
+    char *p;
+
+    memset(buf, 'a', sizeof(buf));
+    ret = write(fd, buf, sizeof(buf));
+    assert(ret == sizeof(buf));
+
+    ret = mmap((void **)&p, fd, 0, sizeof(buf), MMAP_PRIVATE);
+    assert(ret == 0);
+    p[0] = 'b';
+    assert(p[0] == 'b');
+
+    ret = munmap(p);
+    assert(ret == 0);
+
+    /* Writes to a private mapping don't change the file */
+    ret = seek(fd, 0, SEEK_SET);
+    assert(ret == 0);
+    ret = read(fd, buf, 1);
+    assert(ret == 1);
+    assert(buf[0] == 'a');
+
+    close(fd);
+}
+
+static void
+test_mmap_many(void)
+{
+    int fd = mktemp(0);
+    int ret;
+    char buf[4096];
+    char *p[1024];
+    int n;
+
+    memset(buf, 'a', sizeof(buf));
+    ret = write(fd, buf, sizeof(buf));
+    assert(ret == sizeof(buf));
+
+    /* Mapping the same file over and over fails gracefully */
+    for (n = 0; n < (int)(sizeof(p) / sizeof(p[0])); ++n) {
+        if (mmap((void **)&p[n], fd, 0, sizeof(buf), 0) < 0) {
+            break;
+        }
+        assert(p[n][0] == 'a');
+    }
+    assert(n > 255);
+    assert(n < (int)(sizeof(p) / sizeof(p[0])));
+
+    while (n-- > 0) {
+        ret = munmap(p[n]);
+        assert(ret == 0);
+    }
+
+    /* All mappings are gone, so the file is writable again */
+    ret = write(fd, "b", 1);
+    assert(ret == 1);
+
+    close(fd);
+}
+
 static void
 test_open_trunc(void)
 {
@@ -497,6 +597,9 @@ main(void)
     test_write_gap();
     test_write_fill_block();
     test_write_large_file();
+    test_mmap();
+    test_mmap_private();
+    test_mmap_many();
     test_open_trunc();
     test_open_append();
     test_unlink_lazy_delete();
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <syscall.h>
 
 #define SMALL_SIZE_MIN 0
@@ -9,17 +10,92 @@
 #define LARGE_SIZE_MIN 512
 #define LARGE_SIZE_MAX 8192
 #define ITERATION_COUNT 10000
+#define BENCH_SLOTS 1024
+#define BENCH_DURATION_MS 2000
 #define RAND_RANGE(a, b) ((a) + rand() % ((b) - (a)))
 #define RAND_SIZE() \
     ((rand() & 1) \
        ? RAND_RANGE(SMALL_SIZE_MIN, SMALL_SIZE_MAX) \
        : RAND_RANGE(LARGE_SIZE_MIN, LARGE_SIZE_MAX))
 
+/*
+ * Repeatedly runs the specified operation on random slots for
+ * a fixed amount of time, and prints the number of operations
+ * per second.
+ */
+static void
+bench(const char *name, void (*op)(char **slot, size_t size), size_t min_size, size_t max_size)
+{
+    static char *slots[BENCH_SLOTS];
+    int ops = 0;
+    int start = monotime();
+    int elapsed;
+
+    do {
+        int j;
+        for (j = 0; j < 1000; ++j) {
+            op(&slots[rand() % BENCH_SLOTS], RAND_RANGE(min_size, max_size));
+        }
+        ops += 1000;
+        elapsed = monotime() - start;
+    } while (elapsed < BENCH_DURATION_MS);
+
+    int i;
+    for (i = 0; i < BENCH_SLOTS; ++i) {
+        free(slots[i]);
+        slots[i] = NULL;
+    }
+
+    /* Avoid overflowing ops * 1000 */
+    int ops_per_sec = ops / elapsed * 1000 + ops % elapsed * 1000 / elapsed;
+    printf("%s: %d ops/sec\n", name, ops_per_sec);
+}
+
+/* Frees the slot if it is allocated, otherwise allocates it */
+static void
+bench_malloc_free(char **slot, size_t size)
+{
+    if (*slot != NULL) {
+        free(*slot);
+        *slot = NULL;
+    } else {
+        *slot = malloc(size);
+    }
+}
+
+/* Resizes the slot to the specified size */
+static void
+bench_realloc(char **slot, size_t size)
+{
+    char *ptr = realloc(*slot, size);
+    if (ptr != NULL) {
+        *slot = ptr;
+    }
+}
+
+/*
+ * Benchmark mode, run with `testmalloc bench`.
+ */
+static void
+bench_all(void)
+{
+    bench("small malloc/free", bench_malloc_free, 1, SMALL_SIZE_MAX);
+    bench("large malloc/free", bench_malloc_free, LARGE_SIZE_MIN, LARGE_SIZE_MAX);
+    bench("mixed malloc/free", bench_malloc_free, 1, LARGE_SIZE_MAX);
+    bench("realloc", bench_realloc, 1, LARGE_SIZE_MAX);
+}
+
 int
 main(void)
 {
     int i;
 
+    char args[128];
+    if (getargs(args, sizeof(args)) >= 0 && strcmp(args, "bench") == 0) {
+        bench_all();
+        return 0;
+    }
+
     /* sbrk correctness checks */
     assert(sbrk(-2147483647, NULL) < 0);
     assert(sbrk(-2147483647 - 1, NULL) < 0);
@@ -1,11 +1,15 @@
 #include <assert.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <syscall.h>
 
 /* Must keep this in sync with kernel code */
 #define PIPE_CAPACITY 8192
 
+/* Number of processes blocking on the same pipe */
+#define NUM_READERS 4
+
 static void
 test_invalid_args(void)
 {
@@ -113,6 +117,48 @@ test_permissions(void)
     close(writefd);
 }
 
+static void
+test_multiple_readers(void)
+{
+    int ret;
+    int readfd, writefd;
+    int i;
+
+    ret = pipe(&readfd, &writefd);
+    assert(ret == 0);
+
+    for (i = 0; i < NUM_READERS; ++i) {
+        int pid = fork();
+        assert(pid >= 0);
+        if (pid == 0) {
+            int x;
+            ret = read(readfd, &x, sizeof(x));
+            exit(ret == sizeof(x) ? x : 0);
+        }
+    }
+
+    /*
+     * A single write wakes only one reader, which must pass
+     * the leftover data on to the others.
+     */
+    int values[NUM_READERS];
+    for (i = 0; i < NUM_READERS; ++i) {
+        values[i] = i + 1;
+    }
+    ret = write(writefd, values, sizeof(values));
+    assert(ret == sizeof(values));
+
+    int sum = 0;
+    for (i = 0; i < NUM_READERS; ++i) {
+        int pid = 0;
+        sum += wait(&pid);
+    }
+    assert(sum == NUM_READERS * (NUM_READERS + 1) / 2);
+
+    close(readfd);
+    close(writefd);
+}
+
 int
 main(void)
 {
@@ -121,6 +167,7 @@ main(void)
     test_half_duplex_write();
     test_half_duplex_read();
     test_permissions();
+    test_multiple_readers();
     printf("All tests passed!\n");
     return 0;
 }
@@ -0,0 +1,148 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+static void
+test_nice(void)
+{
+    assert(nice(0) == 0);
+    assert(nice(2) == 2);
+    assert(nice(-1) == 1);
+
+    /* Values are clamped to the valid range */
+    assert(nice(0x7fffffff) == NICE_MAX);
+    assert(nice(-0x7fffffff) == NICE_MIN);
+    assert(nice(-1) == NICE_MIN);
+
+    nice(-NICE_MIN);
+    assert(nice(0) == 0);
+}
+
+static void
+test_fork(void)
+{
+    int ret;
+
+    /* Children inherit the nice value of their parent */
+    nice(1);
+    int pid = fork();
+    if (pid == 0) {
+        exit(nice(0) == 1 ? 0 : 1);
+    }
+    assert(pid > 0);
+
+    ret = wait(&pid);
+    assert(ret == 0);
+    nice(-1);
+}
+
+static void
+test_hog(void)
+{
+    int ret;
+
+    /*
+     * A niced CPU hog must not prevent us from running;
+     * we should still get to sleep and wake up on time.
+     */
+    int pid = fork();
+    if (pid == 0) {
+        nice(NICE_MAX);
+        while (1);
+    }
+    assert(pid > 0);
+
+    int i;
+    for (i = 0; i < 10; ++i) {
+        int target = monotime() + 20;
+        sleep(target);
+        assert(monotime() - target < 100);
+    }
+
+    ret = kill(pid, SIGKILL);
+    assert(ret == 0);
+    wait(&pid);
+}
+
+static void
+test_rtprio(void)
+{
+    int ret;
+    volatile int *counter;
+
+    ret = rtprio(-1);
+    assert(ret == -1);
+    ret = rtprio(RTPRIO_MAX + 1);
+    assert(ret == -1);
+
+    int fd = shmopen(NULL, 4096);
+    assert(fd >= 0);
+    ret = mmap((void **)&counter, fd, 0, 4096, 0);
+    assert(ret == 0);
+    close(fd);
+
+    ret = rtprio(1);
+    assert(ret == 0);
+
+    /* Real-time priority is not inherited */
+    int pid = fork();
+    if (pid == 0) {
+        while (1) {
+            (*counter)++;
+        }
+    }
+    assert(pid > 0);
+
+    /* The normal child must not run while we are runnable */
+    int target = monotime() + 50;
+    while (monotime() < target);
+    assert(*counter == 0);
+
+    /* But it runs as soon as we sleep */
+    sleep(monotime() + 20);
+    assert(*counter > 0);
+
+    ret = rtprio(0);
+    assert(ret == 0);
+    ret = kill(pid, SIGKILL);
+    assert(ret == 0);
+    wait(&pid);
+    munmap((void *)counter);
+}
+
+static void
+test_rt_watchdog(void)
+{
+    int ret;
+
+    /*
+     * A real-time process that never sleeps is throttled
+     * once it exceeds its budget, so we still get to run.
+     */
+    int pid = fork();
+    if (pid == 0) {
+        rtprio(RTPRIO_MAX);
+        while (1);
+    }
+    assert(pid > 0);
+
+    ret = sleep(monotime() + 10);
+    assert(ret == 0);
+
+    ret = kill(pid, SIGKILL);
+    assert(ret == 0);
+    wait(&pid);
+}
+
+int
+main(void)
+{
+    test_nice();
+    test_fork();
+    test_hog();
+    test_rtprio();
+    test_rt_watchdog();
+    printf("All tests passed!\n");
+    return 0;
+}
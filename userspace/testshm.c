@@ -0,0 +1,146 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+
+static void
+test_invalid_args(void)
+{
+    int ret;
+    char *p;
+
+    ret = shmopen(NULL, -1);
+    assert(ret == -1);
+
+    int fd = shmopen(NULL, 4096);
+    assert(fd >= 0);
+
+    /* Out of bounds */
+    ret = mmap((void **)&p, fd, 0, 8192, 0);
+    assert(ret == -1);
+
+    /* Unaligned offset */
+    ret = mmap((void **)&p, fd, 1, 1, 0);
+    assert(ret == -1);
+
+    /* Shared memory cannot be mapped privately */
+    ret = mmap((void **)&p, fd, 0, 4096, MMAP_PRIVATE);
+    assert(ret == -1);
+
+    close(fd);
+}
+
+static void
+test_anonymous(void)
+{
+    int ret;
+    char *p, *q;
+
+    int fd = shmopen(NULL, 8192);
+    assert(fd >= 0);
+
+    ret = mmap((void **)&p, fd, 0, 8192, 0);
+    assert(ret == 0);
+    ret = mmap((void **)&q, fd, 4096, 4096, 0);
+    assert(ret == 0);
+
+    /* Memory starts out zeroed */
+    assert(p[0] == 0 && p[8191] == 0);
+
+    /* Both mappings see the same memory */
+    p[4096] = 'a';
+    assert(q[0] == 'a');
+    q[1] = 'b';
+    assert(p[4097] == 'b');
+
+    /* Cannot resize while mapped */
+    ret = truncate(fd, 4096);
+    assert(ret == -1);
+
+    ret = munmap(p);
+    assert(ret == 0);
+    ret = munmap(q);
+    assert(ret == 0);
+
+    ret = truncate(fd, 4096);
+    assert(ret == 0);
+    ret = mmap((void **)&p, fd, 4096, 4096, 0);
+    assert(ret == -1);
+
+    close(fd);
+}
+
+static void
+test_named(void)
+{
+    int ret;
+    char *p, *q;
+
+    int fd1 = shmopen("testshm", 4096);
+    assert(fd1 >= 0);
+
+    /* Size is ignored if the segment already exists */
+    int fd2 = shmopen("testshm", 0);
+    assert(fd2 >= 0);
+
+    ret = mmap((void **)&p, fd1, 0, 4096, 0);
+    assert(ret == 0);
+    ret = mmap((void **)&q, fd2, 0, 4096, 0);
+    assert(ret == 0);
+    p[0] = 'a';
+    assert(q[0] == 'a');
+
+    munmap(p);
+    munmap(q);
+    close(fd1);
+    close(fd2);
+
+    /* Segment is destroyed once nobody references it */
+    fd1 = shmopen("testshm", 4096);
+    assert(fd1 >= 0);
+    ret = mmap((void **)&p, fd1, 0, 4096, 0);
+    assert(ret == 0);
+    assert(p[0] == 0);
+
+    munmap(p);
+    close(fd1);
+}
+
+static void
+test_fork(void)
+{
+    int ret;
+    volatile int *p;
+
+    int fd = shmopen(NULL, 4096);
+    assert(fd >= 0);
+
+    ret = mmap((void **)&p, fd, 0, 4096, 0);
+    assert(ret == 0);
+    close(fd);
+
+    /* Mappings stay shared (not copy-on-write) across fork */
+    int pid = fork();
+    if (pid == 0) {
+        p[0] = 42;
+        exit(0);
+    }
+    assert(pid > 0);
+
+    ret = wait(&pid);
+    assert(ret == 0);
+    assert(p[0] == 42);
+
+    munmap((void *)p);
+}
+
+int
+main(void)
+{
+    test_invalid_args();
+    test_anonymous();
+    test_named();
+    test_fork();
+    printf("All tests passed!\n");
+    return 0;
+}
@@ -0,0 +1,235 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include <thread.h>
+
+#define NUM_THREADS 4
+#define NUM_ITERS 10000
+
+static int shared_value;
+static mutex_t counter_lock = MUTEX_INIT;
+static int counter;
+
+static mutex_t queue_lock = MUTEX_INIT;
+static cond_t queue_cond = COND_INIT;
+static int queue_items;
+static bool queue_done;
+
+static int
+set_shared(void *arg)
+{
+    shared_value = (int)arg;
+    return 42;
+}
+
+static int
+write_pipe(void *arg)
+{
+    int fd = (int)arg;
+    int ret = write(fd, "hi", 2);
+    assert(ret == 2);
+    return 0;
+}
+
+static int
+increment(void *arg)
+{
+    int i;
+    for (i = 0; i < NUM_ITERS; ++i) {
+        mutex_lock(&counter_lock);
+        counter++;
+        mutex_unlock(&counter_lock);
+    }
+    return 0;
+}
+
+static int
+consume(void *arg)
+{
+    int consumed = 0;
+    mutex_lock(&queue_lock);
+    while (1) {
+        while (queue_items == 0 && !queue_done) {
+            cond_wait(&queue_cond, &queue_lock);
+        }
+        if (queue_items == 0) {
+            break;
+        }
+        queue_items--;
+        consumed++;
+    }
+    mutex_unlock(&queue_lock);
+    return consumed;
+}
+
+static int
+alloc_free(void *arg)
+{
+    int i;
+    for (i = 0; i < NUM_ITERS; ++i) {
+        void *p = malloc(1 + i % 300);
+        assert(p != NULL);
+        free(p);
+    }
+    return 0;
+}
+
+static void
+test_invalid_args(void)
+{
+    int ret;
+    int x = 0;
+
+    ret = clone(NULL);
+    assert(ret == -1);
+
+    /* Unaligned address */
+    ret = futex((int *)((char *)&x + 1), FUTEX_WAKE, 1);
+    assert(ret == -1);
+
+    /* Invalid operation */
+    ret = futex(&x, 42, 0);
+    assert(ret == -1);
+
+    /* Invalid address */
+    ret = futex(NULL, FUTEX_WAIT, 0);
+    assert(ret == -1);
+
+    /* Value mismatch */
+    ret = futex(&x, FUTEX_WAIT, 1);
+    assert(ret == -EAGAIN);
+
+    /* No waiters */
+    ret = futex(&x, FUTEX_WAKE, 1);
+    assert(ret == 0);
+}
+
+static void
+test_shared_memory(void)
+{
+    int ret;
+    thread_t thread;
+
+    shared_value = 0;
+    ret = thread_create(&thread, set_shared, (void *)1337, 0);
+    assert(ret == 0);
+
+    int retval;
+    ret = thread_join(&thread, &retval);
+    assert(ret == 0);
+    assert(retval == 42);
+    assert(shared_value == 1337);
+}
+
+static void
+test_shared_files(void)
+{
+    int ret;
+    int readfd, writefd;
+    thread_t thread;
+
+    ret = pipe(&readfd, &writefd);
+    assert(ret == 0);
+
+    ret = thread_create(&thread, write_pipe, (void *)writefd, 0);
+    assert(ret == 0);
+    ret = thread_join(&thread, NULL);
+    assert(ret == 0);
+
+    /* The fd is still open in this thread after the other exits */
+    char buf[2];
+    ret = read(readfd, buf, sizeof(buf));
+    assert(ret == 2);
+    assert(memcmp(buf, "hi", 2) == 0);
+
+    close(readfd);
+    close(writefd);
+}
+
+static void
+test_mutex(void)
+{
+    int ret;
+    int i;
+    thread_t threads[NUM_THREADS];
+
+    counter = 0;
+    for (i = 0; i < NUM_THREADS; ++i) {
+        ret = thread_create(&threads[i], increment, NULL, 0);
+        assert(ret == 0);
+    }
+    for (i = 0; i < NUM_THREADS; ++i) {
+        ret = thread_join(&threads[i], NULL);
+        assert(ret == 0);
+    }
+    assert(counter == NUM_THREADS * NUM_ITERS);
+}
+
+static void
+test_cond(void)
+{
+    int ret;
+    int i;
+    thread_t threads[NUM_THREADS];
+
+    queue_items = 0;
+    queue_done = false;
+    for (i = 0; i < NUM_THREADS; ++i) {
+        ret = thread_create(&threads[i], consume, NULL, 0);
+        assert(ret == 0);
+    }
+
+    for (i = 0; i < NUM_ITERS; ++i) {
+        mutex_lock(&queue_lock);
+        queue_items++;
+        cond_signal(&queue_cond);
+        mutex_unlock(&queue_lock);
+    }
+
+    mutex_lock(&queue_lock);
+    queue_done = true;
+    cond_broadcast(&queue_cond);
+    mutex_unlock(&queue_lock);
+
+    int total = 0;
+    for (i = 0; i < NUM_THREADS; ++i) {
+        int consumed;
+        ret = thread_join(&threads[i], &consumed);
+        assert(ret == 0);
+        total += consumed;
+    }
+    assert(total == NUM_ITERS);
+}
+
+static void
+test_malloc(void)
+{
+    int ret;
+    int i;
+    thread_t threads[NUM_THREADS];
+
+    for (i = 0; i < NUM_THREADS; ++i) {
+        ret = thread_create(&threads[i], alloc_free, NULL, 0);
+        assert(ret == 0);
+    }
+    for (i = 0; i < NUM_THREADS; ++i) {
+        ret = thread_join(&threads[i], NULL);
+        assert(ret == 0);
+    }
+}
+
+int
+main(void)
+{
+    test_invalid_args();
+    test_shared_memory();
+    test_shared_files();
+    test_mutex();
+    test_cond();
+    test_malloc();
+    printf("All tests passed!\n");
+    return 0;
+}
@@ -118,6 +118,14 @@ play(int fd)
         goto exit;
     }
 
+    /*
+     * Run ahead of normal processes so the sound driver never runs
+     * dry, but below music since we do much more work per buffer.
+     */
+    if (rtprio(RTPRIO_MAX - 1) < 0) {
+        fprintf(stderr, "Could not set real-time priority\n");
+    }
+
     if (fbmap(
         (void **)&fbmem,
         (int)hdr.video_width,